@@ -0,0 +1,402 @@
+#ifndef BT_BLOB_TRANSFER_HPP
+#define BT_BLOB_TRANSFER_HPP
+
+#include "frame_codec.hpp"
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Bulk transfer over frames (see frame_codec.hpp).
+ *
+ * The blob is cut into chunks numbered from 0. The sender keeps up to
+ * `window` chunks unacknowledged; the receiver acknowledges cumulatively
+ * with the number of the next chunk it expects and drops anything out of
+ * order (go-back-N). When nothing is acknowledged for `timeout_ms`, the
+ * sender goes back to the oldest unacknowledged chunk.
+ *
+ * Every connection starts with a START, answered by what the receiver
+ * already holds, so a transfer cut by a disconnect resumes where it was.
+ *
+ *   START 'S' | first chunk u32 | size u32 | chunk size u16
+ *   DATA  'D' | chunk u32 | data
+ *   ACK   'A' | next chunk u32
+ *
+ * Integers are little endian. An ACK is preceded by a delimiter, so the
+ * sender's decoder resynchronises after anything else the module sent.
+ */
+
+#define BLOB_START 'S'
+#define BLOB_DATA  'D'
+#define BLOB_ACK   'A'
+
+#define BLOB_START_SIZE  11
+#define BLOB_HEADER_SIZE 5
+#define BLOB_ACK_SIZE    5
+
+enum TransferStatus {
+    TRANSFER_IDLE,
+    TRANSFER_RUNNING,
+    TRANSFER_PAUSED, // link down, resumes once it is back
+    TRANSFER_DONE,
+    TRANSFER_FAILED, // the reader came up short, or the buffer holds no chunk
+};
+
+/**
+ * Supplies `length` bytes of the blob from `offset`. Chunks sent again are
+ * read again. Returns the number of bytes read.
+ */
+typedef size_t (*BlobReader)(uint32_t offset, uint8_t* buffer, size_t length, void* ctx);
+
+/**
+ * Receives the blob in order, every byte once.
+ */
+typedef void (*BlobWriter)(uint32_t offset, const uint8_t* data, size_t length, void* ctx);
+
+inline void blobPut32(uint8_t* out, uint32_t value)
+{
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+inline uint32_t blobGet32(const uint8_t* in)
+{
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+/**
+ * Sending side. The caller supplies the chunk buffer: a chunk is
+ * `capacity - BLOB_HEADER_SIZE` bytes, at most UINT16_MAX, and its encoded
+ * frame has to fit the TX queue it is sent through. `begin()` fails with
+ * TRANSFER_FAILED when the buffer is no larger than BLOB_HEADER_SIZE.
+ *
+ * Driven by `step()` with anything that has `isConnected()` and
+ * `queueFrame()`, fed the receiver's frames through `decoder()` and
+ * `onFrame()`. `Bluetooth::beginTransfer()` does all of it from `poll()`.
+ */
+class BlobSender
+{
+    private:
+        uint8_t* _buffer;
+        uint16_t _chunk_size;
+        uint8_t _window;
+        uint32_t _timeout_ms;
+
+        uint8_t _rx[BLOB_ACK_SIZE + FRAME_CRC_SIZE];
+        FrameDecoder _decoder;
+
+        BlobReader _reader = NULL;
+        void* _ctx         = NULL;
+        uint32_t _size     = 0;
+        uint32_t _chunks   = 0;
+        uint32_t _base     = 0; // oldest unacknowledged chunk
+        uint32_t _next     = 0; // next chunk to send
+        uint32_t _buffered = 0; // chunk read into `_buffer`, if `_has_chunk`
+        bool _has_chunk    = false;
+
+        TransferStatus _status     = TRANSFER_IDLE;
+        bool _synced               = false;
+        bool _start_sent           = false;
+        unsigned long _progress_at = 0;
+
+        uint32_t _sent        = 0;
+        uint32_t _retransmits = 0;
+        uint32_t _resumes     = 0;
+
+        static uint16_t chunkSize(size_t capacity)
+        {
+            if (capacity <= BLOB_HEADER_SIZE)
+                return 0;
+            return capacity - BLOB_HEADER_SIZE < UINT16_MAX ? (uint16_t)(capacity - BLOB_HEADER_SIZE) : UINT16_MAX;
+        }
+
+        size_t chunkLength(uint32_t chunk) const
+        {
+            return min((uint32_t)_chunk_size, _size - chunk * _chunk_size);
+        }
+
+    public:
+        BlobSender(uint8_t* buffer, size_t capacity, uint8_t window = 8, uint32_t timeout_ms = 1000)
+            : _buffer(buffer), _chunk_size(chunkSize(capacity)), _window(window > 0 ? window : 1),
+              _timeout_ms(timeout_ms), _decoder(_rx, sizeof(_rx))
+        {
+        }
+
+        /**
+         * Start sending `size` bytes from `reader`. `offset` is where the
+         * sender believes the receiver stands; the receiver has the last word.
+         */
+        void begin(BlobReader reader, void* ctx, uint32_t size, uint32_t offset = 0)
+        {
+            if (_chunk_size == 0) {
+                _status = TRANSFER_FAILED;
+                return;
+            }
+
+            _reader      = reader;
+            _ctx         = ctx;
+            _size        = size;
+            _chunks      = (size + _chunk_size - 1) / _chunk_size;
+            _base        = min(offset / _chunk_size, _chunks);
+            _next        = _base;
+            _has_chunk   = false;
+            _status      = TRANSFER_RUNNING;
+            _synced      = false;
+            _start_sent  = false;
+            _sent        = 0;
+            _retransmits = 0;
+            _resumes     = 0;
+            _decoder.reset();
+        }
+
+        void cancel()
+        {
+            _status = TRANSFER_IDLE;
+        }
+
+        /**
+         * Change the window, e.g. 1 for stop-and-wait. Applies to the next
+         * chunks sent.
+         */
+        void setWindow(uint8_t window)
+        {
+            _window = window > 0 ? window : 1;
+        }
+
+        bool active() const
+        {
+            return _status == TRANSFER_RUNNING || _status == TRANSFER_PAUSED;
+        }
+
+        TransferStatus status() const
+        {
+            return _status;
+        }
+
+        /**
+         * Bytes the receiver has acknowledged, where to resume from.
+         */
+        uint32_t offset() const
+        {
+            return min(_base * _chunk_size, _size);
+        }
+
+        uint32_t chunksSent() const
+        {
+            return _sent;
+        }
+
+        uint32_t retransmits() const
+        {
+            return _retransmits;
+        }
+
+        uint32_t resumes() const
+        {
+            return _resumes;
+        }
+
+        FrameDecoder* decoder()
+        {
+            return &_decoder;
+        }
+
+        /**
+         * A frame from the receiver; only ACKs are of interest.
+         */
+        void onFrame(const uint8_t* data, size_t length, unsigned long now)
+        {
+            if (!active() || length != BLOB_ACK_SIZE || data[0] != BLOB_ACK)
+                return;
+
+            uint32_t next = min(blobGet32(data + 1), _chunks);
+
+            if (!_synced) {
+                // Answer to START: carry on from what the receiver holds
+                _synced      = true;
+                _base        = next;
+                _next        = next;
+                _progress_at = now;
+            } else if (next > _base && next <= _next) {
+                _base        = next;
+                _progress_at = now;
+            }
+
+            if (_synced && _base == _chunks)
+                _status = TRANSFER_DONE;
+        }
+
+        template <class Link>
+        void step(Link& link, unsigned long now)
+        {
+            if (!active())
+                return;
+
+            if (!link.isConnected()) {
+                _status     = TRANSFER_PAUSED;
+                _synced     = false;
+                _start_sent = false;
+                return;
+            }
+
+            if (_status == TRANSFER_PAUSED) {
+                _status = TRANSFER_RUNNING;
+                _resumes++;
+            }
+
+            if (!_synced) {
+                if (_start_sent && now - _progress_at < _timeout_ms)
+                    return;
+
+                uint8_t start[BLOB_START_SIZE] = { BLOB_START };
+                blobPut32(start + 1, _base);
+                blobPut32(start + 5, _size);
+                start[9]  = (uint8_t)_chunk_size;
+                start[10] = (uint8_t)(_chunk_size >> 8);
+
+                if (link.queueFrame(start, sizeof(start))) {
+                    _start_sent  = true;
+                    _progress_at = now;
+                }
+                return;
+            }
+
+            // Nothing acknowledged for too long: go back to the oldest chunk
+            if (_next > _base && now - _progress_at >= _timeout_ms) {
+                _retransmits += _next - _base;
+                _next        = _base;
+                _progress_at = now;
+            }
+
+            while (_next < _chunks && _next - _base < _window) {
+                const size_t length = chunkLength(_next);
+
+                if (!_has_chunk || _buffered != _next) {
+                    _buffer[0] = BLOB_DATA;
+                    blobPut32(_buffer + 1, _next);
+
+                    if (_reader(_next * _chunk_size, _buffer + BLOB_HEADER_SIZE, length, _ctx) != length) {
+                        _status = TRANSFER_FAILED;
+                        return;
+                    }
+
+                    _buffered  = _next;
+                    _has_chunk = true;
+                }
+
+                if (!link.queueFrame(_buffer, BLOB_HEADER_SIZE + length))
+                    return;
+
+                if (_next == _base)
+                    _progress_at = now;
+                _next++;
+                _sent++;
+            }
+        }
+};
+
+/**
+ * Receiving side, fed byte by byte. The caller supplies the frame buffer,
+ * at least the sender's chunk size + BLOB_HEADER_SIZE + FRAME_CRC_SIZE.
+ */
+class BlobReceiver
+{
+    private:
+        FrameDecoder _decoder;
+        BlobWriter _writer;
+        void* _ctx;
+
+        uint32_t _size         = 0;
+        uint16_t _chunk_size   = 0;
+        uint32_t _next         = 0;
+        bool _started          = false;
+        uint32_t _out_of_order = 0;
+
+        void acknowledge(Print& out)
+        {
+            uint8_t ack[BLOB_ACK_SIZE] = { BLOB_ACK };
+            blobPut32(ack + 1, _next);
+
+            out.write((uint8_t)FRAME_DELIMITER);
+            FrameEncoder::write(out, ack, sizeof(ack));
+        }
+
+    public:
+        BlobReceiver(uint8_t* buffer, size_t capacity, BlobWriter writer, void* ctx = NULL)
+            : _decoder(buffer, capacity), _writer(writer), _ctx(ctx)
+        {
+        }
+
+        /**
+         * Feed one received byte, acknowledgements go to `out`. Returns
+         * `true` once the whole blob has been written.
+         */
+        bool feed(uint8_t c, Print& out)
+        {
+            if (_decoder.feed(c) != FRAME_READY)
+                return complete();
+
+            const uint8_t* data = _decoder.data();
+            const size_t length = _decoder.length();
+
+            if (length == BLOB_START_SIZE && data[0] == BLOB_START) {
+                uint32_t size       = blobGet32(data + 5);
+                uint16_t chunk_size = (uint16_t)(data[9] | data[10] << 8);
+
+                // Another blob: start over, the same one: resume
+                if (!_started || size != _size || chunk_size != _chunk_size) {
+                    _size       = size;
+                    _chunk_size = chunk_size;
+                    _next       = 0;
+                    _started    = true;
+                }
+                acknowledge(out);
+            } else if (length > BLOB_HEADER_SIZE && data[0] == BLOB_DATA && _started) {
+                const uint32_t chunk = blobGet32(data + 1);
+                const size_t size    = length - BLOB_HEADER_SIZE;
+
+                if (chunk == _next && (uint64_t)chunk * _chunk_size + size <= _size) {
+                    _writer(chunk * _chunk_size, data + BLOB_HEADER_SIZE, size, _ctx);
+                    _next++;
+                } else {
+                    _out_of_order++;
+                }
+                acknowledge(out);
+            }
+
+            return complete();
+        }
+
+        bool complete() const
+        {
+            return _started && (uint64_t)_next * _chunk_size >= _size;
+        }
+
+        /**
+         * Bytes written so far.
+         */
+        uint32_t received() const
+        {
+            return min(_next * _chunk_size, _size);
+        }
+
+        uint32_t outOfOrder() const
+        {
+            return _out_of_order;
+        }
+
+        /**
+         * Forget the blob in progress.
+         */
+        void reset()
+        {
+            _started = false;
+            _next    = 0;
+            _decoder.reset();
+        }
+};
+
+#endif
@@ -1,46 +1,64 @@
 #include "bluetooth.hpp"
 
 #include <Arduino.h>
+#include <stdarg.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
 #if __has_include(<SoftwareSerial.h>)
 #include <SoftwareSerial.h>
 #endif
-#include "bucket.hpp"
 
 #define OK_RESPONSE     "+OK"
 #define DEFAULT_TIMEOUT 5000
-#define BUFFER_SIZE     128
+#define CMD_SETTLE_MS   150
+#define PROBE_REPLY_MAX 32
+#define PROBE_MARGIN_MS 5
+#define VERSION_PREFIX  "+VERSION="
 
-char BUFFER[BUFFER_SIZE + 1];
+/**
+ * Command names by AtCommand. Fixed-width rows in flash, so an entry is
+ * addressed directly instead of through a pointer read back from flash.
+ */
+static const char AT_TABLE[AT_COMMANDS][11] PROGMEM = {
+    "AT+VERSION", "AT+NAME", "AT+PIN", "AT+BAUD", "AT+RESET", "AT+DEFAULT", "AT+DISC",
+};
+#define FLASH_COMMAND(command) (reinterpret_cast<const __FlashStringHelper*>(AT_TABLE[command]))
+#define PROBE_LENGTH           (strlen_P(AT_TABLE[AT_VERSION]) + 2)
+
+static const long BAUD_RATES[] = { 9600, 19200, 38400, 57600, 115200, 128000 };
+#define BAUD_RATE_COUNT (sizeof(BAUD_RATES) / sizeof(long))
 
 /**
- * hex is an uppercase character in the range 0..F
+ * Index of `baud` in BAUD_RATES, -1 if the module does not support it.
  */
-uint8_t parse_hex_nibble(char hex)
+static int baudIndex(long baud)
 {
-    /**
-     * '0' is 0x30
-     * 'A' is 0x41
-     *
-     * Substract 0x30 to hex to get 0..9 if hex is a number.
-     * If its greater than 9, substract the distance of 0x30 to 0x41 (0x11)
-     * and add 10 to it.
-     *
-     * 0x11 - 10 = 0x7
-     */
+    for (size_t i = 0; i < BAUD_RATE_COUNT; i++) {
+        if (BAUD_RATES[i] == baud)
+            return i;
+    }
+
+    return -1;
+}
 
-    uint8_t byte = (uint8_t)hex - 0x30;
-    if (byte < 10)
-        return byte;
+/**
+ * Milliseconds `bytes` take on the wire at `baud` (8N1), rounded up.
+ */
+static unsigned long byteTimeMs(long baud, size_t bytes)
+{
+    if (baud <= 0)
+        return 0;
 
-    return byte - 0x07;
+    return (bytes * 10000UL + baud - 1) / baud;
 }
 
 /**
  *  - power_pin: ID of the pin used to control if the hc05 module gets any power.
  *               The implementation of this pin is most probably not built in.
+ *  - listen_for_urc: strip the module's URC lines out of the received data.
+ *               They update the link state and call their handlers either way.
  */
 #ifdef SoftwareSerial_h
 Bluetooth::Bluetooth(int rx, int tx, int cmd_pin, int state_pin, int power_pin, bool inverted_power_pin)
@@ -76,65 +94,248 @@ Bluetooth::Bluetooth(Uart* serial,
 
     if (power_pin >= 0)
         pinMode(power_pin, OUTPUT);
+
+    // An output starts low: off, unless the board inverts the power pin
+    if (power_pin >= 0 && !inverted_power_pin)
+        this->_power_state = POWER_OFF;
 };
 #endif
 
 
 /**
- *
- * Write HIGH on power_pin and wait 500ms for
- * the HC05 module to initialize
+ * Power the module and wait until it is ready (see `requestPowerOn()`).
  */
 void Bluetooth::powerOn()
 {
-    if (this->power_pin >= 0) {
-        digitalWrite(this->power_pin, inverted_power_pin ? LOW : HIGH);
-        delay(500);
-    }
+    this->requestPowerOn();
+
+    while (this->_power_state == POWER_BOOTING)
+        this->poll();
+}
+
+/**
+ * Power the module without waiting, `poll()` then watches it boot.
+ *
+ * The command pin is held high and the module probed until a reply line
+ * arrives or the state pin goes high; if neither happens within
+ * BT_BOOT_TIMEOUT_MS it is taken as ready anyway. Commands and queued data
+ * wait until then; commands submitted meanwhile are sent without leaving
+ * command mode in between. The RX buffer is cleared, as it can only hold data from
+ * before the module went down.
+ */
+void Bluetooth::requestPowerOn()
+{
+    if (this->power_pin < 0 || this->_power_state != POWER_OFF)
+        return;
+
+    digitalWrite(this->power_pin, inverted_power_pin ? LOW : HIGH);
+    this->startBoot();
+}
+
+/**
+ * The module is starting up: data and commands wait until it answers the
+ * boot probes (see `stepBoot()`).
+ */
+void Bluetooth::startBoot()
+{
+    this->clearRx();
+    this->writeCmdPin(HIGH);
+    this->_power_state   = POWER_BOOTING;
+    this->_power_since   = millis();
+    this->_probe_pending = false;
 }
 
 /**
- * Write LOW on power_pin
+ * Cut the power. A command in flight fails with COMMAND_TIMEOUT and a
+ * command session ends, along with any reset deferred to its end:
+ * `inCommandSession()` is false from here on. Commands and data still
+ * queued, or submitted while off, wait until `powerOn()` or
+ * `requestPowerOn()`; only the off windows of a duty cycle end early for them.
  */
 void Bluetooth::powerOff()
 {
-    if (this->power_pin >= 0)
-        digitalWrite(this->power_pin, inverted_power_pin ? HIGH : LOW);
+    if (this->power_pin < 0)
+        return;
+
+    this->cutPower();
+    this->_duty_off = false;
 }
 
-void Bluetooth::setBaud(long baud, uint32_t stop_bits, uint32_t parity)
+/**
+ * Power down and drop the state the module loses with it.
+ */
+void Bluetooth::cutPower()
 {
-    static const long rates[] = { 9600, 19200, 38400, 57600, 115200, 128000 };
+    digitalWrite(this->power_pin, inverted_power_pin ? HIGH : LOW);
+
+    BluetoothCommand* command;
+    while ((command = this->oldestCommand(COMMAND_RUNNING)) != NULL) {
+        if (command->result == COMMAND_QUEUED) {
+            command->response[command->response_length] = 0;
+            command->result                             = COMMAND_TIMEOUT;
+            BT_STAT(this->_stats.timeouts++);
+        }
+        this->finishCommand(command);
+    }
 
-    size_t baud_index = -1;
+    if (this->_cmd_pin_high)
+        this->writeCmdPin(LOW);
+
+    this->_cmd_state       = CMD_IDLE;
+    this->_session         = false;
+    this->_session_closing = false;
+    this->_reset_pending   = false;
+    this->_is_connected    = false;
+    this->_is_connecting   = false;
+    this->_power_state     = POWER_OFF;
+    this->_duty_since      = millis();
+}
 
-    for (size_t i = 0; i < (sizeof(rates) / sizeof(long)); i++) {
-        if (rates[i] == baud) {
-            baud_index = i;
-            break;
+PowerState Bluetooth::powerState()
+{
+    return this->_power_state;
+}
+
+/**
+ * Milliseconds from the last power on until the module was ready, 0 before the first one.
+ */
+unsigned long Bluetooth::wakeLatency()
+{
+    return this->_wake_ms;
+}
+
+/**
+ * Let `poll()` cycle the power: on for `on_ms` once ready, then off for
+ * `off_ms`, over and over. The module is not powered off while a command
+ * or queued data is pending, nor, with `stay_awake_connected`, while a peer
+ * is connecting or connected. Commands or data submitted during an off
+ * window power it on early. A module that is off when the cycle starts
+ * counts as being in an off window.
+ */
+void Bluetooth::setDutyCycle(uint32_t on_ms, uint32_t off_ms, bool stay_awake_connected)
+{
+    this->_duty_on_ms          = on_ms;
+    this->_duty_off_ms         = off_ms;
+    this->_duty_stay_connected = stay_awake_connected;
+    this->_duty_cycling        = this->power_pin >= 0;
+    this->_duty_off            = this->_power_state == POWER_OFF;
+    this->_duty_since          = millis();
+}
+
+void Bluetooth::stopDutyCycle()
+{
+    this->_duty_cycling = false;
+}
+
+/**
+ * Off by `powerOff()`, or from the start, rather than in a duty-cycle off window.
+ */
+bool Bluetooth::powerHeld()
+{
+    return this->_power_state == POWER_OFF && !(this->_duty_cycling && this->_duty_off);
+}
+
+/**
+ * Power state machine, run by `poll()`.
+ */
+void Bluetooth::stepPower()
+{
+    if (this->_power_state == POWER_BOOTING && this->stepBoot()) {
+        this->_wake_ms = millis() - this->_power_since;
+        BT_STAT(this->_stats.wakes++);
+        BT_STAT(this->_stats.wake_latency.record(this->_wake_ms));
+
+        // Commands queued meanwhile run in the command mode the probes used,
+        // anything else waits for the module to be back in data mode
+        if (this->oldestCommand(COMMAND_QUEUED) != NULL && this->_tx.available() == 0) {
+            this->_cmd_state = CMD_ACTIVE;
+        } else {
+            this->writeCmdPin(LOW);
+            this->_cmd_since = millis();
+            this->_cmd_state = CMD_EXITING;
         }
+        this->_power_state = POWER_READY;
+        this->_duty_since  = millis();
     }
 
-    // Baud rate not found
-    if (baud_index == -1)
+    // An off window ends when it has elapsed or work is submitted; after
+    // `powerOff()` the module stays off until powered on again
+    if (this->_power_state == POWER_OFF && !this->powerHeld()
+        && (this->oldestCommand(COMMAND_QUEUED) != NULL || this->_tx.available() > 0
+            || millis() - this->_duty_since >= this->_duty_off_ms)) {
+        this->requestPowerOn();
         return;
+    }
 
-    this->setCmdPin(HIGH);
+    if (!this->_duty_cycling || this->_power_state != POWER_READY)
+        return;
 
-    this->write("AT+BAUD");
-    this->print(baud_index + 4);
-    this->write("\r\n");
-    delay(100);
+    unsigned long elapsed = millis() - this->_duty_since;
 
-    size_t recvd  = this->readBytes(BUFFER, BUFFER_SIZE);
-    BUFFER[recvd] = 0;
+    if (elapsed < this->_duty_on_ms)
+        return;
 
-    this->setCmdPin(LOW);
+    if ((this->_duty_stay_connected && (this->_is_connecting || this->isConnected())) || this->_cmd_state != CMD_IDLE
+        || this->commandPending() || this->_tx.available() > 0)
+        return;
+
+    this->cutPower();
+    this->_duty_off = true;
+}
+
+/**
+ * While booting: probe the module, one probe at a time. Returns `true` once
+ * any reply line arrived, the state pin is high or BT_BOOT_TIMEOUT_MS have passed.
+ * Before `begin()` there is no baud to probe at, only the last two apply.
+ */
+bool Bluetooth::stepBoot()
+{
+    if (this->state_pin >= 0 && digitalRead(this->state_pin))
+        return true;
+
+    while (this->_rx.available() > 0) {
+        char c = (char)this->_rx.pop();
+
+        if (c == '\n' && this->_probe_reply > 0)
+            return true;
+
+        if (c != '\r' && c != '\n')
+            this->_probe_reply++;
+    }
+
+    if (millis() - this->_power_since >= BT_BOOT_TIMEOUT_MS)
+        return true;
+
+    if (this->_baud == 0)
+        return false;
+
+    unsigned long probe_timeout = byteTimeMs(this->_baud, PROBE_LENGTH + PROBE_REPLY_MAX) + PROBE_MARGIN_MS;
+    if (this->_probe_pending && millis() - this->_probe_sent_at < probe_timeout)
+        return false;
+
+    this->sendAt(AT_VERSION, NULL);
+    this->_probe_pending = true;
+    this->_probe_sent_at = millis();
+    this->_probe_reply   = 0;
+    return false;
+}
+
+void Bluetooth::setBaud(long baud, uint32_t stop_bits, uint32_t parity)
+{
+    int baud_index = baudIndex(baud);
+
+    // Baud rate not found
+    if (baud_index == -1)
+        return;
+
+    const char arg[] = { (char)('0' + baud_index + 4), 0 };
 
     // Failed to set baud rate
-    if (recvd > 0 && strcmp(BUFFER, OK_RESPONSE) == 0)
+    if (this->runCommand(AT_BAUD, arg, DEFAULT_TIMEOUT, this->_buffer, BT_BUFFER_SIZE) != COMMAND_DONE
+        || strcmp(this->_buffer, OK_RESPONSE) != 0)
         return;
 
+    this->storeConfig(CONFIG_BAUD, "+BAUD=", arg);
 
     this->reset();
     this->end();
@@ -149,18 +350,13 @@ void Bluetooth::setBaud(long baud)
 
 unsigned long Bluetooth::findBaud()
 {
-
-    static const long rates[] = { 9600, 19200, 38400, 57600, 115200, 128000 };
-
-    int numRates = sizeof(rates) / sizeof(long);
-    int response = false;
-    int recvd    = 0;
+    int recvd = 0;
 
     this->setCmdPin(HIGH);
 
-    for (int rn = numRates - 1; rn >= 0; rn--) {
+    for (int rn = BAUD_RATE_COUNT - 1; rn >= 0; rn--) {
 
-        const long baud = rates[rn];
+        const long baud = BAUD_RATES[rn];
         this->begin(baud);
         this->setTimeout(100);
 
@@ -168,10 +364,10 @@ unsigned long Bluetooth::findBaud()
          * From the specs, the jdy-31 has no "AT" command.
          * Use "AT+VERSION" as a replacement
          */
-        this->write("AT+VERSION\r\n");
+        this->sendAt(AT_VERSION, NULL);
         delay(10);
 
-        recvd = this->readBytes(BUFFER, BUFFER_SIZE);
+        recvd = this->readBytes(this->_buffer, BT_BUFFER_SIZE);
 
         if (recvd > 0) {
             this->setCmdPin(LOW);
@@ -183,250 +379,2103 @@ unsigned long Bluetooth::findBaud()
     return 0;
 }
 
-bool Bluetooth::isConnected()
+/**
+ * Faster alternative to `findBaud()`.
+ *
+ * `hint` is the rate most likely to be right (e.g. the last one that
+ * worked), 0 if unknown. It is tried first, the others follow from fastest
+ * to slowest. Each probe waits only as long as the command and a reply take
+ * on the wire at that rate and is abandoned on the first byte that cannot
+ * start a version reply; a rate is accepted on a complete `+VERSION=` line,
+ * which also fills the configuration cache.
+ *
+ * While the module is settling into command mode (and no peer would
+ * receive the probes as data) the hint, or every rate without one, is
+ * probed repeatedly instead of waiting CMD_SETTLE_MS first.
+ *
+ * Returns the rate found, or 0 with the port back at its previous rate.
+ */
+unsigned long Bluetooth::discoverBaud(long hint)
 {
-    return this->_is_connected || (digitalRead(this->state_pin) ? true : false);
-}
+    long order[BAUD_RATE_COUNT];
+    size_t count     = 0;
+    int hint_index   = baudIndex(hint);
+    long previous    = this->_baud;
+    uint8_t verified = 0;
+    size_t next      = 0;
+    long found       = 0;
+    char reply[PROBE_REPLY_MAX + 1];
+
+    if (hint_index >= 0)
+        order[count++] = hint;
+
+    for (int i = BAUD_RATE_COUNT - 1; i >= 0; i--) {
+        if (i != hint_index)
+            order[count++] = BAUD_RATES[i];
+    }
 
-size_t Bluetooth::poll()
-{
-    return this->readLine(BUFFER, BUFFER_SIZE);
-}
+    this->writeCmdPin(HIGH);
 
-void Bluetooth::handleConnectionURC(const char* str)
-{
-    if (strstr(str, "+CONNECTING") != NULL) {
-        this->_is_connecting = true;
-    } else if (strstr(str, "CONNECTED") != NULL && this->_is_connecting) {
-        this->_is_connecting = false;
-        this->_is_connected  = true;
-    } else if (strstr(str, "+DISC:SUCCESS") != NULL) {
-        this->_is_connecting = false;
-        this->_is_connected  = false;
+    const unsigned long entered = millis();
+    const bool probe_early      = this->_settle_mode == SETTLE_ADAPTIVE && !this->isConnected();
+
+    // A rate only counts as ruled out once probed after the module must have settled
+    while (found == 0 && verified != (1 << count) - 1) {
+        bool settled = millis() - entered >= CMD_SETTLE_MS;
+        size_t index;
+
+        if (!settled && !probe_early) {
+            delay(CMD_SETTLE_MS - (millis() - entered));
+            continue;
+        }
+
+        if (!settled) {
+            index = hint_index >= 0 ? 0 : next++ % count;
+        } else {
+            for (index = 0; verified & (1 << index); index++)
+                ;
+        }
+
+        if (this->probeBaud(order[index], reply, sizeof(reply)))
+            found = order[index];
+        else if (settled)
+            verified |= 1 << index;
     }
+
+    if (found != 0) {
+        unsigned long elapsed = millis() - entered;
+        int found_index       = baudIndex(found);
+
+        // Answering before CMD_SETTLE_MS measured the settle time as well
+        if (elapsed < CMD_SETTLE_MS && this->_settle_ms[found_index] == 0)
+            this->_settle_ms[found_index] = elapsed;
+
+        this->storeConfig(CONFIG_VERSION, "", reply);
+    } else if (previous > 0)
+        this->begin(previous);
+
+    this->setCmdPin(LOW);
+    return found;
 }
 
 /**
- * Waits for connection for `timeout` ms.
- * Will wait forever if `timeout` is negative.
- *
- * Will return `true` if theres a connection.
+ * Send the probe command at `baud` and check the reply is a version line.
+ * On success `reply` holds the line without its line ending.
  */
-bool Bluetooth::waitForConnection(unsigned long timeout)
+bool Bluetooth::probeBaud(long baud, char* reply, size_t length)
 {
-    bool connected                = false;
-    const unsigned long init_time = millis();
+    const size_t prefix_length = strlen(VERSION_PREFIX);
+    size_t received            = 0;
 
-    while ((timeout < 0 || millis() - init_time <= timeout) && !connected) {
-        this->readLine(BUFFER, BUFFER_SIZE);
-        connected = this->isConnected();
+    this->begin(baud);
+    this->sendAt(AT_VERSION, NULL);
+
+    const unsigned long sent_at = millis();
+    const unsigned long timeout = byteTimeMs(baud, PROBE_LENGTH + PROBE_REPLY_MAX) + PROBE_MARGIN_MS;
+
+    while (millis() - sent_at < timeout) {
+        this->drainRx();
+
+        int c;
+        while ((c = this->_rx.pop()) >= 0) {
+            if (c == '\r' || (c == '\n' && received == 0))
+                continue;
+
+            if (c == '\n') {
+                if (received > prefix_length) {
+                    reply[min(received, length - 1)] = 0;
+                    return true;
+                }
+                return false;
+            }
+
+            if (received < prefix_length && c != VERSION_PREFIX[received])
+                return false;
+
+            if (received < length - 1)
+                reply[received] = (char)c;
+            received++;
+        }
     }
 
-    return connected;
+    return false;
 }
 
-int Bluetooth::readLine(char* buffer, int length)
+bool Bluetooth::isConnected()
 {
-    return this->readBytesUntil('\n', buffer, length);
-};
+    return this->_is_connected || (digitalRead(this->state_pin) ? true : false);
+}
 
 /**
- * Sets command pin state and waits to enter/exit command mode
+ * Moves received bytes into the RX buffer, sends as much queued data as
+ * the rate limit allows, drives the power state, queued commands and hands
+ * frames or lines to their handler when one is set, then resumes the flows
+ * whose wait is over. Never waits. Returns the number of bytes received.
  */
-void Bluetooth::setCmdPin(int state)
+size_t Bluetooth::poll()
 {
-    if (this->cmd_pin >= 0) {
-        digitalWrite(this->cmd_pin, state);
-
-        /**
-         * Wait an arbitrary time to entry and exit command mode.
-         * There is no specs on this time,
-         * but it appears to depend on baud rate, with/ >100ms required at 9600 baud.
-         */
-        delay(150);
+    size_t recvd = this->drainRx();
+    this->flushPrint();
+    this->drainTx();
+    this->stepPower();
+    this->stepCommands();
+    this->stepFrames();
+    this->stepLines();
+
+    if (this->transferActive()) {
+        this->_transfer->step(*this, millis());
+        this->drainTx();
     }
+
+    this->_scheduler.run();
+    return recvd;
 }
 
 /**
- * Send command without waiting for the response.
- * ! User must read or flush the buffer before and after calling this method.
+ * Moves everything the Uart holds into the RX buffer, scanning each byte
+ * once for URCs on the way. When the buffer is full new bytes are dropped
+ * (and counted), but still scanned. With BT_ISR_RX they stay in the ISR
+ * queue instead.
  */
-void Bluetooth::sendCommand(char* cmd, uint32_t timeout)
+size_t Bluetooth::drainRx()
 {
-    int recvd = 0;
-    this->setCmdPin(HIGH);
-
-    this->write(cmd);
-    this->write("\r\n");
-    this->setTimeout(timeout);
+    size_t recvd = 0;
+
+#if BT_ISR_RX
+    // The Uart belongs to the interrupt handler, which fills _isr_rx. Only
+    // take what the RX buffer has room for (held URC bytes included), the
+    // rest waits in the queue.
+    uint8_t chunk[32];
+    size_t length;
+
+    while (this->_rx.free() > this->_urc_held
+           && (length = this->_isr_rx.pop(chunk, min(sizeof(chunk), this->_rx.free() - this->_urc_held))) > 0) {
+        recvd += length;
+        BT_STAT(this->_stats.rx_bytes += length);
+
+        for (size_t i = 0; i < length; i++)
+            this->scanUrc((char)chunk[i]);
+    }
+#else
+    while (this->serial->available() > 0) {
+        uint8_t c = (uint8_t)this->serial->read();
+        recvd++;
+        BT_STAT(this->_stats.rx_bytes++);
 
-    this->setCmdPin(LOW);
-};
+        this->scanUrc((char)c);
+    }
+#endif
 
-void Bluetooth::getVersion(char* buffer, int length)
-{
-    this->sendCommand("AT+VERSION", DEFAULT_TIMEOUT);
-    this->readLine(buffer, length);
-}
+    // The module sends a URC in one go: held bytes followed by a line's
+    // worth of silence are data (e.g. a peer's message ending in "\nC")
+    if (this->_urc_held > 0 && millis() - this->_urc_held_at >= byteTimeMs(this->_baud, BT_URC_LENGTH)) {
+        this->releaseUrc();
+        this->_urc_state = this->_urc_line[0] == '+' && !this->isConnected() ? URC_LINE_UNKNOWN : URC_LINE_PASS;
+    }
 
-void Bluetooth::getBauds(char* buffer, int length)
-{
-    this->sendCommand("AT+BAUD", DEFAULT_TIMEOUT);
-    this->readLine(buffer, length);
+    return recvd;
 }
 
-void Bluetooth::getName(char* buffer, int length)
+/**
+ * Drop everything received and not read yet.
+ */
+void Bluetooth::clearRx()
 {
-    this->sendCommand("AT+NAME", DEFAULT_TIMEOUT);
-    this->readLine(buffer, length);
+    this->_rx.clear();
+#if BT_ISR_RX
+    this->_isr_rx.clear();
+#endif
+    this->resetUrc();
 }
 
-void Bluetooth::getPin(char* buffer, int length)
+void Bluetooth::pushRx(uint8_t value)
 {
-    this->sendCommand("AT+PIN", DEFAULT_TIMEOUT);
-    this->readLine(buffer, length);
+    if (!this->_rx.push(value))
+        this->_rx_overflows++;
 }
 
-bool Bluetooth::setName(char* name)
+/**
+ * Keeps URC lines out of the data stream when `listen_for_urc` is set.
+ *
+ * The start of every line is held back for as long as it matches a known
+ * URC prefix. A URC is acted on as soon as its prefix is complete, the rest
+ * of its line is dropped and its handler called at the line end. Anything
+ * else is released into the RX buffer unchanged. A line starting with '+'
+ * while no peer is connected can only come from the module and is reported
+ * as an unknown URC, but still passed on.
+ *
+ * Without `listen_for_urc`, while a command is in flight, the command pin is
+ * high or frames are being decoded, every byte is passed on so replies and
+ * binary data are never touched; URCs still update the state and call their
+ * handlers. Bytes held back are released once the line stays quiet for as
+ * long as a URC takes to arrive (see `drainRx()`).
+ * Between frames, a URC starts after the delimiter ending the last one.
+ */
+void Bluetooth::scanUrc(char c)
 {
-    strncpy(BUFFER, "AT+NAME", BUFFER_SIZE);
-    strncat(BUFFER, name, BUFFER_SIZE);
-
-    this->sendCommand(BUFFER, 1000);
-    this->readLine(BUFFER, BUFFER_SIZE);
-
-    Serial.print("SetName buffer: ");
-    Serial.println(BUFFER);
-
-    if (strcmp(BUFFER, OK_RESPONSE) != 0)
-        return false;
+    const bool binary   = this->_frame_decoder != NULL || this->transferActive();
+    const bool strip    = this->listen_for_urc && this->_cmd_state == CMD_IDLE && !this->_cmd_pin_high && !binary;
+    const bool line_end = c == '\n' || c == '\r' || (binary && c == FRAME_DELIMITER);
+
+    UrcType urc = this->_urc.feed(c);
+    if (urc != URC_NONE) {
+        const bool connected = this->_is_connected;
+        this->_urc_connecting |= urc == URC_CONNECTING;
+        this->handleURC(urc);
+
+        // Only a change of the link state is an event
+        if (this->_is_connected != connected)
+            this->_urc_type = urc;
+    }
 
-    this->reset();
-    return true;
-}
+    if (!line_end)
+        this->appendUrcLine(c);
 
-bool Bluetooth::setPin(char* pin)
-{
-    strncpy(BUFFER, "AT+PIN", BUFFER_SIZE);
-    strncat(BUFFER, pin, BUFFER_SIZE);
+    if (this->_urc_state == URC_LINE_MATCHED) {
+        if (c == '\n')
+            this->endUrcLine();
+        return;
+    }
 
-    this->sendCommand(BUFFER, DEFAULT_TIMEOUT);
-    this->readLine(BUFFER, BUFFER_SIZE);
+    if (this->_urc_state == URC_LINE_SCAN) {
+        if (strip && urc != URC_NONE) {
+            this->_urc_state = URC_LINE_MATCHED;
+            this->_urc_held  = 0;
+            return;
+        }
 
-    Serial.print("SetPin buffer: ");
-    Serial.println(BUFFER);
+        if (strip && !line_end && this->_urc.matching()) {
+            this->_urc_held++;
+            this->_urc_held_at = millis();
+            return;
+        }
 
-    if (strcmp(BUFFER, OK_RESPONSE) != 0)
-        return false;
+        // Not a URC after all: release what was held back before this byte
+        this->releaseUrc();
 
-    this->reset();
-    return true;
-}
+        if (!line_end)
+            this->_urc_state
+                = this->_urc_line[0] == '+' && !this->isConnected() ? URC_LINE_UNKNOWN : URC_LINE_PASS;
+    }
 
-void Bluetooth::reset()
-{
-    this->sendCommand("AT+RESET", DEFAULT_TIMEOUT);
-    this->readLine(BUFFER, BUFFER_SIZE);
+    this->pushRx(c);
 
-    // Wait an arbitraty time
-    delay(100);
+    if (c == '\n' || (binary && c == FRAME_DELIMITER))
+        this->endUrcLine();
 }
 
-void Bluetooth::resetFactory()
+/**
+ * Passes the bytes held back as a possible URC on to the RX buffer.
+ */
+void Bluetooth::releaseUrc()
 {
-    this->sendCommand("AT+DEFAULT", DEFAULT_TIMEOUT);
-    this->readLine(BUFFER, BUFFER_SIZE);
-
-    // Wait an arbitraty time
-    delay(100);
+    for (uint8_t i = 0; i < this->_urc_held; i++)
+        this->pushRx(this->_urc_line[i]);
+    this->_urc_held = 0;
 }
 
-void Bluetooth::disconnect()
+void Bluetooth::appendUrcLine(char c)
 {
-    this->sendCommand("AT+DISC", DEFAULT_TIMEOUT);
-    this->_is_connected  = false;
-    this->_is_connecting = false;
-    this->readLine(BUFFER, BUFFER_SIZE);
+    if (this->_urc_length < BT_URC_LENGTH)
+        this->_urc_line[this->_urc_length++] = c;
 }
 
 /**
- * Define all methods that would be provided by SoftwareSerial,
- * bind methods to this->serial
+ * Calls the handler for the line that just ended, if any, and starts the next line.
  */
-
-#ifndef SofwareSerial_H
-void Bluetooth::flush()
+void Bluetooth::endUrcLine()
 {
-    this->serial->flush();
-};
+    int event = -1;
 
-int Bluetooth::read()
-{
-    return this->serial->read();
-};
+    if (this->_urc_type == URC_CONNECTED)
+        event = URC_EVENT_CONNECT;
+    else if (this->_urc_type == URC_DISCONNECTED)
+        event = URC_EVENT_DISCONNECT;
+    else if (this->_urc_state == URC_LINE_UNKNOWN)
+        event = URC_EVENT_UNKNOWN;
 
-size_t Bluetooth::readBytesUntil(char terminator, char* buffer, size_t length)
-{
-    size_t recv = this->serial->readBytesUntil(terminator, buffer, length);
-    this->handleConnectionURC(buffer);
-    return recv;
-};
+    this->_urc_line[this->_urc_length] = 0;
 
-void Bluetooth::begin(unsigned long baudRate)
-{
-    this->serial->begin(baudRate);
-}
+    // "+CONNECTING<<98:D3:31:FB:12:34"
+    ModuleResponse response;
+    if (this->_urc_connecting && ResponseParser::parse(this->_urc_line, this->_urc_length, &response)
+        && response.kind == RESPONSE_CONNECTING)
+        memcpy(this->client_mac, response.mac, sizeof(this->client_mac));
 
-void Bluetooth::begin(unsigned long baudrate, uint16_t config)
-{
-    this->serial->begin(baudrate, config);
+    if (event >= 0 && this->_urc_callbacks[event] != NULL)
+        this->_urc_callbacks[event](this, this->_urc_line, this->_urc_ctx[event]);
+
+    this->resetUrc();
 }
 
-void Bluetooth::end()
+void Bluetooth::resetUrc()
 {
-    this->serial->end();
+    this->_urc.reset();
+    this->_urc_state      = URC_LINE_SCAN;
+    this->_urc_type       = URC_NONE;
+    this->_urc_length     = 0;
+    this->_urc_held       = 0;
+    this->_urc_connecting = false;
 }
 
-int Bluetooth::available()
+/**
+ * Called once the link is up ("CONNECTED").
+ */
+void Bluetooth::onConnect(UrcCallback callback, void* ctx)
 {
-    return this->serial->available();
+    this->_urc_callbacks[URC_EVENT_CONNECT] = callback;
+    this->_urc_ctx[URC_EVENT_CONNECT]       = ctx;
 }
 
-int Bluetooth::availableForWrite()
+/**
+ * Called once the link is gone ("+DISC:SUCCESS").
+ */
+void Bluetooth::onDisconnect(UrcCallback callback, void* ctx)
 {
-    return this->serial->availableForWrite();
+    this->_urc_callbacks[URC_EVENT_DISCONNECT] = callback;
+    this->_urc_ctx[URC_EVENT_DISCONNECT]       = ctx;
 }
 
-int Bluetooth::peek()
+/**
+ * Called for lines the module sends on its own that are not a known URC.
+ */
+void Bluetooth::onUnknownUrc(UrcCallback callback, void* ctx)
 {
-    return this->serial->peek();
+    this->_urc_callbacks[URC_EVENT_UNKNOWN] = callback;
+    this->_urc_ctx[URC_EVENT_UNKNOWN]       = ctx;
 }
 
-void Bluetooth::setTimeout(long timeout)
+void Bluetooth::handleURC(UrcType urc)
 {
+    BT_STAT(this->_stats.urcs[urc]++);
+
+    if (urc == URC_CONNECTING) {
+        this->_is_connecting = true;
+        BT_STAT(this->_stats.connecting_since = millis());
+    } else if (urc == URC_CONNECTED && this->_is_connecting) {
+        this->_is_connecting = false;
+        this->_is_connected  = true;
+        BT_STAT(this->_stats.connects++);
+        BT_STAT(this->_stats.connect_latency.record(millis() - this->_stats.connecting_since));
+    } else if (urc == URC_DISCONNECTED) {
+        BT_STAT(this->_stats.disconnects += this->_is_connected);
+        this->_is_connecting = false;
+        this->_is_connected  = false;
+    }
+}
+
+/**
+ * Print the address of the last peer that connected, as in its URC
+ * (98:D3:31:FB:12:34). All zero until one has.
+ */
+void Bluetooth::printClientMAC(bool new_line)
+{
+    for (int i = 0; i < 6; i++) {
+        if (i > 0)
+            Serial.print(':');
+        if (this->client_mac[i] < 0x10)
+            Serial.print('0');
+        Serial.print(this->client_mac[i], HEX);
+    }
+
+    if (new_line)
+        Serial.println();
+}
+
+/**
+ * Polls, then returns `true` once for every connection that came up since
+ * the last call; `client_mac` then holds the peer address.
+ */
+bool Bluetooth::handlNewConnection()
+{
+    this->poll();
+
+    const bool connected       = this->isConnected();
+    const bool new_connection = connected && !this->_reported_connected;
+    this->_reported_connected = connected;
+    return new_connection;
+}
+
+/**
+ * Waits for connection for `timeout` ms.
+ * Will wait forever if `timeout` is negative.
+ *
+ * Will return `true` if theres a connection.
+ */
+bool Bluetooth::waitForConnection(unsigned long timeout)
+{
+    bool connected                = false;
+    const unsigned long init_time = millis();
+
+    while ((timeout < 0 || millis() - init_time <= timeout) && !connected) {
+        this->poll();
+        connected = this->isConnected();
+    }
+
+    return connected;
+}
+
+/**
+ * Blocks until a line arrives or the Stream timeout runs out.
+ * See `pollLine()` and `setLineHandler()` for the non-blocking way.
+ */
+int Bluetooth::readLine(char* buffer, int length)
+{
+    return this->readBytesUntil('\n', buffer, length);
+};
+
+/**
+ * Feeds received data to the line assembler until a line is complete.
+ * Partial lines are kept for the next call. Left alone while a command is
+ * reading replies.
+ */
+bool Bluetooth::assembleLine()
+{
+    while (this->_cmd_state == CMD_IDLE) {
+        const uint8_t* data;
+        size_t length = this->_rx.peekContiguous(&data);
+        size_t used   = 0;
+
+        if (length == 0)
+            return false;
+
+        this->_line_status = LINE_PENDING;
+        while (used < length && this->_line_status == LINE_PENDING)
+            this->_line_status = this->_line.feed((char)data[used++]);
+
+        this->_rx.consume(used);
+
+        if (this->_line_status != LINE_PENDING)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Non-blocking `readLine()`: copies the next complete line (NUL-terminated,
+ * without `\r\n`) into `buffer` and returns its length, or returns -1 at
+ * once if no full line has arrived yet.
+ *
+ * `overflow`, if given, is set when the line was longer than BT_LINE_LENGTH
+ * or `length - 1` and has been cut.
+ */
+int Bluetooth::pollLine(char* buffer, int length, bool* overflow)
+{
+    this->drainRx();
+
+    if (length <= 0 || !this->assembleLine())
+        return -1;
+
+    size_t copied = min(this->_line.length(), (size_t)length - 1);
+    memcpy(buffer, this->_line.line(), copied);
+    buffer[copied] = 0;
+
+    if (overflow != NULL)
+        *overflow = this->_line_status == LINE_OVERFLOW || copied < this->_line.length();
+
+    return copied;
+}
+
+/**
+ * Have `poll()` assemble received data into lines and hand each one to
+ * `callback`. Pass NULL to go back to reading the stream directly.
+ * Ignored while a frame handler is set.
+ */
+void Bluetooth::setLineHandler(LineCallback callback, void* ctx)
+{
+    this->_line_callback = callback;
+    this->_line_ctx      = ctx;
+}
+
+void Bluetooth::stepLines()
+{
+    while (this->_line_callback != NULL && this->_frame_decoder == NULL && this->assembleLine()) {
+        this->_line_callback(this,
+                             this->_line.line(),
+                             this->_line.length(),
+                             this->_line_status == LINE_OVERFLOW,
+                             this->_line_ctx);
+    }
+}
+
+/**
+ * Lines cut because they were longer than BT_LINE_LENGTH.
+ */
+uint32_t Bluetooth::lineOverflows()
+{
+    return this->_line.overflows();
+}
+
+void Bluetooth::writeCmdPin(int state)
+{
+    this->_cmd_pin_high = state == HIGH;
+
+    if (this->cmd_pin >= 0)
+        digitalWrite(this->cmd_pin, state);
+}
+
+/**
+ * Sets command pin state and waits to enter/exit command mode
+ */
+void Bluetooth::setCmdPin(int state)
+{
+    if (this->cmd_pin >= 0) {
+        this->writeCmdPin(state);
+
+        /**
+         * Wait an arbitrary time to entry and exit command mode.
+         * There is no specs on this time,
+         * but it appears to depend on baud rate, with/ >100ms required at 9600 baud.
+         */
+        delay(this->settleTime(this->_baud));
+        BT_STAT(this->_stats.settle_ms += this->settleTime(this->_baud));
+    }
+}
+
+/**
+ * Stream the name of `command` from flash, then `text` (may be NULL) and
+ * the line ending, straight to the UART. AT_TEXT sends `text` alone.
+ * Returns the bytes written.
+ */
+size_t Bluetooth::sendAt(uint8_t command, const char* text)
+{
+    size_t sent = 0;
+
+    if (command != AT_TEXT)
+        sent += this->serial->print(FLASH_COMMAND(command));
+    if (text != NULL)
+        sent += this->serial->write(text);
+    sent += this->serial->write("\r\n");
+
+    BT_STAT(this->_stats.tx_bytes += sent);
+    return sent;
+}
+
+/**
+ * Send command without waiting for the response.
+ * ! User must read or flush the buffer before and after calling this method.
+ */
+void Bluetooth::sendCommand(char* cmd, uint32_t timeout)
+{
+    this->setCmdPin(HIGH);
+
+    // Straight to the UART: the TX queue is held while the pin is high
+    this->sendAt(AT_TEXT, cmd);
+    this->setTimeout(timeout);
+
+    this->setCmdPin(LOW);
+};
+
+/**
+ * Queue `cmd` followed by `arg` (may be NULL) for the command engine.
+ * Returns a handle to query with `commandStatus()`/`commandResponse()`,
+ * or -1 if the command does not fit or every slot is busy.
+ *
+ * The command is sent and its response collected by subsequent `poll()` calls.
+ * Results stay readable until the slot is reused by a later submission.
+ */
+int Bluetooth::submitCommand(const char* cmd, const char* arg, uint32_t timeout, CommandCallback callback, void* ctx)
+{
+    return this->queueCommand(AT_TEXT, cmd, arg, timeout, callback, ctx);
+}
+
+/**
+ * Same for a command of the table: only `arg` is kept in the slot, the
+ * name is streamed from flash when the command is sent.
+ */
+int Bluetooth::submitCommand(AtCommand cmd, const char* arg, uint32_t timeout, CommandCallback callback, void* ctx)
+{
+    return this->queueCommand(cmd, NULL, arg, timeout, callback, ctx);
+}
+
+int Bluetooth::queueCommand(AtCommand command,
+                            const char* cmd,
+                            const char* arg,
+                            uint32_t timeout,
+                            CommandCallback callback,
+                            void* ctx)
+{
+    size_t cmd_length = cmd != NULL ? strlen(cmd) : 0;
+    size_t arg_length = arg != NULL ? strlen(arg) : 0;
+
+    if (cmd_length + arg_length > BT_COMMAND_LENGTH)
+        return -1;
+
+    // Reuse a free slot, or else the one holding the oldest result
+    BluetoothCommand* slot = NULL;
+    for (int i = 0; i < BT_COMMAND_SLOTS; i++) {
+        BluetoothCommand* candidate = &this->_commands[i];
+
+        if (candidate->status == COMMAND_QUEUED || candidate->status == COMMAND_RUNNING)
+            continue;
+
+        if (slot == NULL || candidate->status == COMMAND_UNKNOWN
+            || (slot->status != COMMAND_UNKNOWN && candidate->handle < slot->handle))
+            slot = candidate;
+    }
+
+    if (slot == NULL)
+        return -1;
+
+    memcpy(slot->text, cmd, cmd_length);
+    memcpy(slot->text + cmd_length, arg, arg_length);
+    slot->text[cmd_length + arg_length] = 0;
+
+    slot->command         = command;
+    slot->handle          = this->_next_handle++;
+    slot->status          = COMMAND_QUEUED;
+    slot->result          = COMMAND_QUEUED;
+    slot->timeout         = timeout;
+    slot->callback        = callback;
+    slot->ctx             = ctx;
+    slot->sent_at         = 0;
+    slot->response[0]     = 0;
+    slot->response_length = 0;
+    BT_STAT(slot->submitted_at = millis());
+
+    return slot->handle;
+}
+
+BluetoothCommand* Bluetooth::findCommand(int handle)
+{
+    for (int i = 0; i < BT_COMMAND_SLOTS; i++) {
+        if (this->_commands[i].status != COMMAND_UNKNOWN && this->_commands[i].handle == handle)
+            return &this->_commands[i];
+    }
+
+    return NULL;
+}
+
+CommandStatus Bluetooth::commandStatus(int handle)
+{
+    BluetoothCommand* command = this->findCommand(handle);
+    return command != NULL ? command->status : COMMAND_UNKNOWN;
+}
+
+/**
+ * Reply line of a completed command, NULL while it is still in flight.
+ */
+const char* Bluetooth::commandResponse(int handle)
+{
+    BluetoothCommand* command = this->findCommand(handle);
+
+    if (command == NULL || command->status == COMMAND_QUEUED || command->status == COMMAND_RUNNING)
+        return NULL;
+
+    return command->response;
+}
+
+bool Bluetooth::commandPending()
+{
+    for (int i = 0; i < BT_COMMAND_SLOTS; i++) {
+        if (this->_commands[i].status == COMMAND_QUEUED || this->_commands[i].status == COMMAND_RUNNING)
+            return true;
+    }
+
+    return false;
+}
+
+/**
+ * Submit a command and poll the engine until it completes.
+ * The reply is copied NUL-terminated into `response` when given.
+ * Returns COMMAND_QUEUED without waiting while `powerOff()` holds the
+ * command; it still runs once the module is powered on.
+ */
+CommandStatus Bluetooth::runCommand(const char* cmd, const char* arg, uint32_t timeout, char* response, int length)
+{
+    return this->waitCommand(this->submitCommand(cmd, arg, timeout), response, length);
+}
+
+CommandStatus Bluetooth::runCommand(AtCommand cmd, const char* arg, uint32_t timeout, char* response, int length)
+{
+    return this->waitCommand(this->submitCommand(cmd, arg, timeout), response, length);
+}
+
+CommandStatus Bluetooth::waitCommand(int handle, char* response, int length)
+{
+    if (handle < 0) {
+        if (response != NULL && length > 0)
+            response[0] = 0;
+        return COMMAND_UNKNOWN;
+    }
+
+    CommandStatus status;
+    while (((status = this->commandStatus(handle)) == COMMAND_QUEUED && !this->powerHeld())
+           || status == COMMAND_RUNNING)
+        this->poll();
+
+    if (response != NULL && length > 0) {
+        // NULL once the slot has been reused, e.g. by a callback
+        const char* reply = this->commandResponse(handle);
+
+        strncpy(response, reply != NULL ? reply : "", length - 1);
+        response[length - 1] = 0;
+    }
+
+    return status;
+}
+
+/**
+ * Command state machine.
+ *
+ * Enter command mode, send, collect the first non-empty reply line and
+ * exit command mode, waiting for the module to settle on every pin change.
+ * Never blocks: returns as soon as the current state has to wait.
+ *
+ * A command only starts once the TX queue is empty, and the queue is held
+ * while in command mode, so queued data is never sent as a command.
+ */
+void Bluetooth::stepCommands()
+{
+    // A closing session ends once everything issued in it is done
+    if (this->_session_closing && this->oldestCommand(COMMAND_QUEUED) == NULL
+        && this->oldestCommand(COMMAND_RUNNING) == NULL) {
+        this->_session         = false;
+        this->_session_closing = false;
+    }
+
+    for (;;) {
+        switch (this->_cmd_state) {
+            case CMD_IDLE:
+                if (this->oldestCommand(COMMAND_QUEUED) == NULL || this->_tx.available() > 0
+                    || this->_power_state != POWER_READY)
+                    return;
+
+                this->writeCmdPin(HIGH);
+                this->_cmd_since     = millis();
+                this->_probe_pending = false;
+                this->_cmd_state     = CMD_ENTERING;
+                break;
+
+            case CMD_ENTERING:
+                if (!this->stepSettle())
+                    return;
+
+                BT_STAT(this->_stats.settle_ms += millis() - this->_cmd_since);
+                this->_cmd_state = CMD_ACTIVE;
+                break;
+
+            case CMD_ACTIVE:
+                if (!this->stepActive())
+                    return;
+
+                this->writeCmdPin(LOW);
+                this->_cmd_since = millis();
+                this->_cmd_state = CMD_EXITING;
+                break;
+
+            case CMD_EXITING:
+                if (this->cmd_pin >= 0 && millis() - this->_cmd_since < this->settleTime(this->_baud))
+                    return;
+
+                BT_STAT(this->_stats.settle_ms += millis() - this->_cmd_since);
+                this->_cmd_state = CMD_IDLE;
+                this->finishCommands();
+                break;
+        }
+    }
+}
+
+/**
+ * In command mode: send queued commands and match reply lines to them in
+ * the order they were sent.
+ *
+ * Outside a session one command is sent at a time and command mode is left
+ * as soon as it is answered. Inside a session up to `pipeline_depth`
+ * commands are in flight at once, each completes as its reply arrives and
+ * command mode is kept until the session ends.
+ *
+ * Returns `true` when it is time to leave command mode.
+ */
+bool Bluetooth::stepActive()
+{
+    const uint8_t depth = this->_session ? this->_pipeline_depth : 1;
+    bool progress       = true;
+
+    while (progress) {
+        progress = false;
+
+        BluetoothCommand* command;
+        uint8_t in_flight = 0;
+        for (int i = 0; i < BT_COMMAND_SLOTS; i++) {
+            if (this->_commands[i].status == COMMAND_RUNNING)
+                in_flight++;
+        }
+
+        while (in_flight < depth && (command = this->oldestCommand(COMMAND_QUEUED)) != NULL) {
+            this->sendAt(command->command, command->text);
+            BT_STAT(this->_stats.commands++);
+
+            command->status  = COMMAND_RUNNING;
+            command->sent_at = millis();
+            in_flight++;
+        }
+
+        this->drainRx();
+
+        command = this->oldestCommand(COMMAND_RUNNING);
+        if (command == NULL) {
+            if (this->_session_closing && this->oldestCommand(COMMAND_QUEUED) == NULL) {
+                this->_session         = false;
+                this->_session_closing = false;
+            }
+            return !this->_session;
+        }
+
+        if (!this->collectResponse(command)) {
+            if (millis() - command->sent_at < command->timeout)
+                return false;
+
+            command->response[command->response_length] = 0;
+            command->result                             = COMMAND_TIMEOUT;
+            BT_STAT(this->_stats.timeouts++);
+
+            // The learned settle time may have been too short, learn it again
+            int baud_index = baudIndex(this->_baud);
+            if (baud_index >= 0)
+                this->_settle_ms[baud_index] = 0;
+        }
+
+        BT_STAT(this->_stats.command_latency[command->command != AT_TEXT ? (StatsCommand)command->command
+                                                                         : BluetoothStats::classify(command->text)]
+                    .record(millis() - command->submitted_at));
+        BT_STAT(this->_stats.command_errors += command->result == COMMAND_ERROR);
+
+        if (!this->_session)
+            return true;
+
+        this->finishCommand(command);
+        progress = true;
+    }
+
+    return false;
+}
+
+/**
+ * Wait for the module to enter command mode. Returns `true` once it has.
+ *
+ * In SETTLE_ADAPTIVE mode the time learned for the current baud rate is
+ * used when known. Otherwise, and only while no peer is connected (probes
+ * would reach it as data), the module is probed with AT+VERSION, one probe
+ * at a time, until it answers or CMD_SETTLE_MS have passed. The time it
+ * took is learned for the next commands.
+ */
+bool Bluetooth::stepSettle()
+{
+    if (this->cmd_pin < 0)
+        return true;
+
+    unsigned long elapsed = millis() - this->_cmd_since;
+    int baud_index        = baudIndex(this->_baud);
+
+    if (this->_settle_mode == SETTLE_FIXED || baud_index < 0 || this->_settle_ms[baud_index] != 0
+        || this->isConnected())
+        return elapsed >= this->settleTime(this->_baud);
+
+    if (this->_probe_pending) {
+        this->drainRx();
+
+        // Any reply line means the module is listening
+        while (this->_rx.available() > 0) {
+            char c = (char)this->_rx.pop();
+
+            if (c == '\n' && this->_probe_reply > 0) {
+                unsigned long learned = this->_probe_sent_at - this->_cmd_since
+                                        + byteTimeMs(this->_baud, PROBE_LENGTH);
+                this->_settle_ms[baud_index] = min(learned, (unsigned long)CMD_SETTLE_MS);
+                return true;
+            }
+
+            if (c != '\r' && c != '\n')
+                this->_probe_reply++;
+        }
+
+        unsigned long probe_timeout = byteTimeMs(this->_baud, PROBE_LENGTH + PROBE_REPLY_MAX) + PROBE_MARGIN_MS;
+        if (millis() - this->_probe_sent_at < probe_timeout)
+            return false;
+
+        // Give up probing and stick to the fixed wait at this baud rate
+        if (millis() - this->_cmd_since >= CMD_SETTLE_MS) {
+            this->_settle_ms[baud_index] = CMD_SETTLE_MS;
+            return true;
+        }
+    }
+
+    this->sendAt(AT_VERSION, NULL);
+    this->_probe_pending = true;
+    this->_probe_sent_at = millis();
+    this->_probe_reply   = 0;
+    return false;
+}
+
+/**
+ * Time waited for the module to follow the command pin at `baud`:
+ * CMD_SETTLE_MS in SETTLE_FIXED mode or until a time has been learned,
+ * the learned time plus a margin otherwise.
+ */
+unsigned long Bluetooth::settleTime(long baud)
+{
+    int baud_index = baudIndex(baud);
+
+    if (this->_settle_mode == SETTLE_FIXED || baud_index < 0 || this->_settle_ms[baud_index] == 0)
+        return CMD_SETTLE_MS;
+
+    unsigned long learned = this->_settle_ms[baud_index];
+    return min(learned + learned / 8 + 2, (unsigned long)CMD_SETTLE_MS);
+}
+
+/**
+ * Settle time learned at `baud`, 0 if not learned yet.
+ */
+unsigned long Bluetooth::learnedSettleTime(long baud)
+{
+    int baud_index = baudIndex(baud);
+    return baud_index >= 0 ? this->_settle_ms[baud_index] : 0;
+}
+
+void Bluetooth::setSettleMode(SettleMode mode)
+{
+    this->_settle_mode = mode;
+}
+
+/**
+ * Move received bytes into the reply of `command`.
+ * Returns `true` once a complete, non-empty line has been received.
+ */
+bool Bluetooth::collectResponse(BluetoothCommand* command)
+{
+    while (this->_rx.available() > 0) {
+        char c = (char)this->_rx.pop();
+
+        if (c == '\r')
+            continue;
+
+        if (c != '\n') {
+            if (command->response_length < BT_RESPONSE_LENGTH)
+                command->response[command->response_length++] = c;
+            continue;
+        }
+
+        // Skip blank lines before the reply
+        if (command->response_length == 0)
+            continue;
+
+        command->response[command->response_length] = 0;
+
+        // A connect URC that was still on its way is never the reply
+        ModuleResponse parsed;
+        ResponseParser::parse(command->response, command->response_length, &parsed);
+        if (parsed.kind == RESPONSE_CONNECTING || parsed.kind == RESPONSE_CONNECTED) {
+            command->response_length = 0;
+            continue;
+        }
+
+        // Nor is a version line, unless asked for: it answers a settle or
+        // boot probe that was given up on before the module replied
+        if (parsed.kind == RESPONSE_VERSION && command->command != AT_VERSION
+            && (command->command != AT_TEXT || strcmp_P(command->text, AT_TABLE[AT_VERSION]) != 0)) {
+            command->response_length = 0;
+            continue;
+        }
+
+        command->result = parsed.kind == RESPONSE_ERROR ? COMMAND_ERROR : COMMAND_DONE;
+        return true;
+    }
+
+    return false;
+}
+
+BluetoothCommand* Bluetooth::oldestCommand(CommandStatus status)
+{
+    BluetoothCommand* oldest = NULL;
+
+    for (int i = 0; i < BT_COMMAND_SLOTS; i++) {
+        BluetoothCommand* candidate = &this->_commands[i];
+
+        if (candidate->status == status && (oldest == NULL || candidate->handle < oldest->handle))
+            oldest = candidate;
+    }
+
+    return oldest;
+}
+
+void Bluetooth::finishCommand(BluetoothCommand* command)
+{
+    command->status = command->result;
+
+    // The module reboots, dropping the link without a URC
+    if ((command->command == AT_RESET || command->command == AT_DEFAULT) && command->status == COMMAND_DONE) {
+        this->_is_connected  = false;
+        this->_is_connecting = false;
+    }
+
+    if (command->callback != NULL)
+        command->callback(this, command->handle, command->status, command->response, command->ctx);
+}
+
+/**
+ * Report every answered command, once back in data mode.
+ */
+void Bluetooth::finishCommands()
+{
+    BluetoothCommand* command;
+
+    while ((command = this->oldestCommand(COMMAND_RUNNING)) != NULL && command->result != COMMAND_QUEUED)
+        this->finishCommand(command);
+}
+
+/**
+ * Keep the module in command mode across commands until `endCommandSession()`.
+ *
+ * Commands submitted meanwhile, including those issued by the helpers, are
+ * pipelined and complete as soon as their reply arrives. Resets requested by
+ * `reset()`, `setName()` or `setPin()` are deferred and done once at the end.
+ */
+void Bluetooth::beginCommandSession()
+{
+    this->_session         = true;
+    this->_session_closing = false;
+}
+
+/**
+ * Does not wait: commands already submitted still run in the session, which
+ * closes, and leaves command mode, once they are done.
+ */
+void Bluetooth::endCommandSession()
+{
+    if (!this->inCommandSession())
+        return;
+
+    if (this->_reset_pending) {
+        this->_reset_pending = false;
+        this->submitCommand(AT_RESET, NULL, DEFAULT_TIMEOUT);
+    }
+
+    this->_session_closing = true;
+}
+
+bool Bluetooth::inCommandSession()
+{
+    return this->_session && !this->_session_closing;
+}
+
+/**
+ * Commands in flight at once during a session. 1 disables pipelining.
+ */
+void Bluetooth::setPipelineDepth(uint8_t depth)
+{
+    this->_pipeline_depth = depth > 0 ? depth : 1;
+}
+
+/**
+ * Replies to the configuration queries are cached: the first call runs the
+ * command, later ones are served from memory until a setter changes the
+ * value, `resetFactory()` or `invalidateConfig()` is called.
+ */
+void Bluetooth::queryConfig(ConfigItem item, char* buffer, int length)
+{
+    static const AtCommand queries[CONFIG_ITEMS] = { AT_VERSION, AT_NAME, AT_PIN, AT_BAUD };
+
+    if (!(this->_config_valid & (1 << item))) {
+        this->_config_misses++;
+
+        if (this->runCommand(queries[item], NULL, DEFAULT_TIMEOUT, this->_config[item], BT_RESPONSE_LENGTH + 1)
+            == COMMAND_DONE)
+            this->_config_valid |= 1 << item;
+    } else {
+        this->_config_hits++;
+    }
+
+    if (buffer != NULL && length > 0) {
+        strncpy(buffer, this->_config[item], length - 1);
+        buffer[length - 1] = 0;
+    }
+}
+
+/**
+ * Record a value the module accepted, in the form its query would return.
+ */
+void Bluetooth::storeConfig(ConfigItem item, const char* prefix, const char* value)
+{
+    snprintf(this->_config[item], BT_RESPONSE_LENGTH + 1, "%s%s", prefix, value);
+    this->_config_valid |= 1 << item;
+}
+
+void Bluetooth::invalidateConfig()
+{
+    this->_config_valid = 0;
+}
+
+/**
+ * Drop the cache and query every setting again.
+ */
+void Bluetooth::refreshConfig()
+{
+    this->invalidateConfig();
+
+    for (int item = 0; item < CONFIG_ITEMS; item++)
+        this->queryConfig((ConfigItem)item, NULL, 0);
+}
+
+uint32_t Bluetooth::configCacheHits()
+{
+    return this->_config_hits;
+}
+
+uint32_t Bluetooth::configCacheMisses()
+{
+    return this->_config_misses;
+}
+
+/**
+ * Cached reply to the query for `item`, parsed in place.
+ */
+bool Bluetooth::parseConfig(ConfigItem item, ModuleResponse* response)
+{
+    static const ResponseKind kinds[CONFIG_ITEMS] = { RESPONSE_VERSION, RESPONSE_NAME, RESPONSE_PIN, RESPONSE_BAUD };
+
+    this->queryConfig(item, NULL, 0);
+    return ResponseParser::parse(this->_config[item], strlen(this->_config[item]), response)
+           && response->kind == kinds[item];
+}
+
+/**
+ * Module firmware version, without the "+VERSION=" prefix. Points into the
+ * config cache: valid until the value is queried again (`refreshConfig()`,
+ * `invalidateConfig()`, a setter...). Empty if the module did not answer.
+ */
+BtStringView Bluetooth::versionView()
+{
+    ModuleResponse response;
+    return this->parseConfig(CONFIG_VERSION, &response) ? response.value : BtStringView { "", 0 };
+}
+
+/**
+ * Same as `versionView()` for the device name.
+ */
+BtStringView Bluetooth::nameView()
+{
+    ModuleResponse response;
+    return this->parseConfig(CONFIG_NAME, &response) ? response.value : BtStringView { "", 0 };
+}
+
+/**
+ * Same as `versionView()` for the pairing pin.
+ */
+BtStringView Bluetooth::pinView()
+{
+    ModuleResponse response;
+    return this->parseConfig(CONFIG_PIN, &response) ? response.value : BtStringView { "", 0 };
+}
+
+/**
+ * Baud rate the module is configured for, 0 if unknown.
+ */
+long Bluetooth::moduleBaud()
+{
+    ModuleResponse response;
+    if (!this->parseConfig(CONFIG_BAUD, &response))
+        return 0;
+
+    int index = response.baud_index - 4;
+    return index >= 0 && index < (int)BAUD_RATE_COUNT ? BAUD_RATES[index] : 0;
+}
+
+void Bluetooth::getVersion(char* buffer, int length)
+{
+    this->queryConfig(CONFIG_VERSION, buffer, length);
+}
+
+void Bluetooth::getBauds(char* buffer, int length)
+{
+    this->queryConfig(CONFIG_BAUD, buffer, length);
+}
+
+void Bluetooth::getName(char* buffer, int length)
+{
+    this->queryConfig(CONFIG_NAME, buffer, length);
+}
+
+void Bluetooth::getPin(char* buffer, int length)
+{
+    this->queryConfig(CONFIG_PIN, buffer, length);
+}
+
+bool Bluetooth::setName(char* name)
+{
+    CommandStatus status = this->runCommand(AT_NAME, name, 1000, this->_buffer, BT_BUFFER_SIZE);
+
+    if (status != COMMAND_DONE || strcmp(this->_buffer, OK_RESPONSE) != 0)
+        return false;
+
+    this->storeConfig(CONFIG_NAME, "+NAME=", name);
+
+    this->reset();
+    return true;
+}
+
+bool Bluetooth::setPin(char* pin)
+{
+    CommandStatus status = this->runCommand(AT_PIN, pin, DEFAULT_TIMEOUT, this->_buffer, BT_BUFFER_SIZE);
+
+    if (status != COMMAND_DONE || strcmp(this->_buffer, OK_RESPONSE) != 0)
+        return false;
+
+    this->storeConfig(CONFIG_PIN, "+PIN=", pin);
+
+    this->reset();
+    return true;
+}
+
+/**
+ * Whether the module takes every staged setting: a printable name, a four
+ * digit pin and a baud rate it supports. `false` when nothing is staged.
+ */
+bool Bluetooth::checkConfig(const BluetoothConfig& config)
+{
+    if (config.staged == 0)
+        return false;
+
+    if (config.has(CONFIG_NAME)) {
+        if (config.name[0] == 0)
+            return false;
+
+        for (const char* c = config.name; *c != 0; c++) {
+            if (*c < ' ' || *c > '~')
+                return false;
+        }
+    }
+
+    if (config.has(CONFIG_PIN)) {
+        if (strlen(config.pin) != 4)
+            return false;
+
+        for (const char* c = config.pin; *c != 0; c++) {
+            if (*c < '0' || *c > '9')
+                return false;
+        }
+    }
+
+    return !config.has(CONFIG_BAUD) || baudIndex(config.baud) >= 0;
+}
+
+/**
+ * Apply the staged settings in one command mode window and reset the
+ * module once, where `setName()`, `setPin()` and `setBaud()` reset it
+ * each. Then waits for the module to answer again, at the new baud rate
+ * when one was staged, and reads the settings back into the config cache.
+ *
+ * Blocks until done and closes any command session. Nothing is sent
+ * unless `checkConfig()` passes. A module that refuses a setting is not
+ * reset: the settings it took apply at its next reset.
+ */
+ApplyStatus Bluetooth::applyConfig(const BluetoothConfig& config)
+{
+    static const ConfigItem items[]   = { CONFIG_NAME, CONFIG_PIN, CONFIG_BAUD };
+    static const AtCommand commands[] = { AT_NAME, AT_PIN, AT_BAUD };
+
+    if (!this->checkConfig(config))
+        return APPLY_INVALID;
+
+    const char baud[]    = { (char)('0' + baudIndex(config.baud) + 4), 0 };
+    const char* values[] = { config.name, config.pin, baud };
+    int handles[3]       = { -1, -1, -1 };
+    bool accepted        = true;
+
+    this->beginCommandSession();
+
+    for (int i = 0; i < 3; i++) {
+        if (config.has(items[i]))
+            handles[i] = this->submitCommand(commands[i], values[i], DEFAULT_TIMEOUT);
+    }
+
+    for (int i = 0; i < 3; i++) {
+        if (config.has(items[i]))
+            accepted = this->waitCommand(handles[i], this->_buffer, BT_BUFFER_SIZE) == COMMAND_DONE
+                       && strcmp(this->_buffer, OK_RESPONSE) == 0 && accepted;
+    }
+
+    if (accepted) {
+        this->_reset_pending = false;
+        accepted             = this->runCommand(AT_RESET, NULL, DEFAULT_TIMEOUT) == COMMAND_DONE;
+    }
+
+    this->endCommandSession();
+    while (this->_cmd_state != CMD_IDLE)
+        this->poll();
+
+    if (!accepted)
+        return APPLY_FAILED;
+
+    if (config.has(CONFIG_BAUD)) {
+        this->end();
+        this->begin(config.baud);
+    }
+
+    // Read back, queued so it runs in the command mode of the boot probes
+    this->startBoot();
+    this->invalidateConfig();
+    this->beginCommandSession();
+
+    for (int i = 0; i < 3; i++) {
+        if (config.has(items[i]))
+            handles[i] = this->submitCommand(commands[i], NULL, DEFAULT_TIMEOUT);
+    }
+
+    this->endCommandSession();
+
+    for (int i = 0; i < 3; i++) {
+        if (config.has(items[i])
+            && this->waitCommand(handles[i], this->_config[items[i]], BT_RESPONSE_LENGTH + 1) == COMMAND_DONE)
+            this->_config_valid |= 1 << items[i];
+    }
+
+    if ((config.has(CONFIG_NAME) && !this->nameView().equals(config.name))
+        || (config.has(CONFIG_PIN) && !this->pinView().equals(config.pin))
+        || (config.has(CONFIG_BAUD) && this->moduleBaud() != config.baud))
+        return APPLY_MISMATCH;
+
+    return APPLY_DONE;
+}
+
+void Bluetooth::reset()
+{
+    if (this->inCommandSession()) {
+        this->_reset_pending = true;
+        return;
+    }
+
+    this->runCommand(AT_RESET, NULL, DEFAULT_TIMEOUT);
+
+    // Wait an arbitraty time
+    delay(100);
+}
+
+void Bluetooth::resetFactory()
+{
+    this->runCommand(AT_DEFAULT, NULL, DEFAULT_TIMEOUT);
+    this->invalidateConfig();
+
+    // Wait an arbitraty time
+    delay(100);
+}
+
+void Bluetooth::disconnect()
+{
+    this->runCommand(AT_DISC, NULL, DEFAULT_TIMEOUT);
+    this->_is_connected  = false;
+    this->_is_connecting = false;
+}
+
+/**
+ * Define all methods that would be provided by SoftwareSerial,
+ * bind methods to this->serial
+ */
+
+#ifndef SofwareSerial_H
+/**
+ * Sends what is staged and queued, waiting at most DEFAULT_TIMEOUT ms for
+ * the rate limit and the Uart. Only the TX path runs: no handlers, flows
+ * or commands, so it is safe from within them. Data held by a command, the
+ * command pin or the power state stays queued for `poll()`; `flushTx()`
+ * drives those too.
+ */
+void Bluetooth::flush()
+{
+    const unsigned long init_time = millis();
+
+    while (this->txQueued() > 0 && millis() - init_time < DEFAULT_TIMEOUT) {
+        if (this->_cmd_state != CMD_IDLE || this->_cmd_pin_high || this->_power_state != POWER_READY)
+            break;
+
+        this->flushPrint();
+        this->drainTx();
+    }
+    this->serial->flush();
+};
+
+int Bluetooth::read()
+{
+    this->drainRx();
+    return this->_rx.pop();
+};
+
+/**
+ * Like Stream::readBytesUntil(), served from the RX buffer.
+ * Gives up after the stream timeout passes without new data.
+ */
+size_t Bluetooth::readBytesUntil(char terminator, char* buffer, size_t length)
+{
+    size_t recvd             = 0;
+    bool found               = false;
+    unsigned long last_recvd = millis();
+
+    while (recvd < length) {
+        this->drainRx();
+
+        size_t chunk = this->_rx.readUntil(terminator, (uint8_t*)buffer + recvd, length - recvd, &found);
+        recvd += chunk;
+
+        if (found)
+            break;
+
+        if (chunk > 0)
+            last_recvd = millis();
+        else if (millis() - last_recvd >= this->_timeout)
+            break;
+    }
+
+    return recvd;
+};
+
+void Bluetooth::begin(unsigned long baudRate)
+{
+    this->serial->begin(baudRate);
+    this->_baud = baudRate;
+    this->clearRx();
+    this->_line.reset();
+}
+
+void Bluetooth::begin(unsigned long baudrate, uint16_t config)
+{
+    this->serial->begin(baudrate, config);
+    this->_baud = baudrate;
+    this->clearRx();
+    this->_line.reset();
+}
+
+void Bluetooth::end()
+{
+    this->serial->end();
+}
+
+int Bluetooth::available()
+{
+    this->drainRx();
+    return this->_rx.available();
+}
+
+/**
+ * Room left in the TX queue for BLE devices, in the Uart otherwise.
+ * Staged bytes count as queued.
+ */
+int Bluetooth::availableForWrite()
+{
+    if (this->using_le_device)
+        return this->_tx.free() > this->_print_length ? this->_tx.free() - this->_print_length : 0;
+
+    return this->serial->availableForWrite();
+}
+
+int Bluetooth::peek()
+{
+    this->drainRx();
+    return this->_rx.peek();
+}
+
+void Bluetooth::setTimeout(long timeout)
+{
+    Stream::setTimeout(timeout);
     this->serial->setTimeout(timeout);
 }
 
-#define BUCKET_SIZE            50
-#define BUCKET_TOKEN_REFILL_MS 1
-Bucket bucket(BUCKET_SIZE, BUCKET_TOKEN_REFILL_MS);
+/**
+ * Zero-copy access to received data: points `data` at the oldest bytes in
+ * the RX buffer and returns how many are contiguous there.
+ * Release them with `consume()`.
+ */
+size_t Bluetooth::peekBuffer(const uint8_t** data)
+{
+    this->drainRx();
+    return this->_rx.peekContiguous(data);
+}
+
+void Bluetooth::consume(size_t length)
+{
+    this->_rx.consume(length);
+}
+
+/**
+ * Bytes dropped because the RX buffer was full.
+ */
+uint32_t Bluetooth::rxOverflows()
+{
+    return this->_rx_overflows;
+}
 
+/**
+ * One byte. Staged while print buffering is on (see `setPrintBuffering()`),
+ * queued or handed to the Uart at once otherwise.
+ */
 size_t Bluetooth::write(const uint8_t value)
 {
+    if (this->_print_buffering) {
+        if (this->_print_length == BT_PRINT_BUFFER_SIZE && !this->flushPrint())
+            return 0;
+
+        this->_print_buffer[this->_print_length++] = value;
+        if (value == '\n' || this->_print_length == BT_PRINT_BUFFER_SIZE)
+            this->flushPrint();
+        return 1;
+    }
+
+    // Left staged by a partial flush, it has to go first
+    if (!this->flushPrint())
+        return 0;
+
     // For BLE Devices we have observed a bug where the device looses bytes if they are send too fast.
     // This is we have designid this simple bucket system to limit the speed of bytes send to the device.
-    if (using_le_device) {
-        bucket.request_token();
+    // Bytes are queued and paced out by poll() instead of waiting for a token here.
+    if (using_le_device || !this->txReady()) {
+        if (!this->_tx.push(value)) {
+            this->drainTx();
+            if (!this->_tx.push(value))
+                return 0;
+        }
+
+        this->drainTx();
+        return 1;
     }
+
+    BT_STAT(this->_stats.tx_bytes++);
     return this->serial->write(value);
 }
 
+/**
+ * Bulk write, also used by print()/println(). Staged like single bytes
+ * while print buffering is on, but with nothing staged, a write of a whole
+ * staging buffer or more goes straight to `sendBulk()`. Returns how much
+ * was accepted.
+ */
+size_t Bluetooth::write(const uint8_t* buffer, size_t size)
+{
+    if (!this->_print_buffering)
+        return this->flushPrint() ? this->sendBulk(buffer, size) : 0;
+
+    size_t staged = 0;
+
+    while (staged < size) {
+        if (this->_print_length == 0 && size - staged >= BT_PRINT_BUFFER_SIZE)
+            return staged + this->sendBulk(buffer + staged, size - staged);
+
+        size_t count = min(size - staged, (size_t)(BT_PRINT_BUFFER_SIZE - this->_print_length));
+        memcpy(this->_print_buffer + this->_print_length, buffer + staged, count);
+        this->_print_length += count;
+
+        const bool line_end = memchr(buffer + staged, '\n', count) != NULL;
+        staged += count;
+
+        if (line_end || this->_print_length == BT_PRINT_BUFFER_SIZE) {
+            this->flushPrint();
+            if (this->_print_length == BT_PRINT_BUFFER_SIZE)
+                break;
+        }
+    }
+
+    return staged;
+}
+
+/**
+ * Like print(), formatted straight into the staging buffer. Output longer
+ * than BT_PRINT_BUFFER_SIZE is cut there. Returns the number of bytes
+ * accepted; without print buffering, what the TX queue could not take is
+ * dropped rather than left staged.
+ */
+size_t Bluetooth::printf(const char* format, ...)
+{
+    if (!this->_print_buffering && !this->flushPrint())
+        return 0;
+
+    va_list args;
+    size_t room = BT_PRINT_BUFFER_SIZE - this->_print_length;
+
+    va_start(args, format);
+    int length = vsnprintf((char*)this->_print_buffer + this->_print_length, room + 1, format, args);
+    va_end(args);
+
+    if (length < 0)
+        return 0;
+
+    // Did not fit behind what is staged: send that and format again
+    if ((size_t)length > room && this->_print_length > 0) {
+        this->flushPrint();
+        room = BT_PRINT_BUFFER_SIZE - this->_print_length;
+
+        va_start(args, format);
+        vsnprintf((char*)this->_print_buffer + this->_print_length, room + 1, format, args);
+        va_end(args);
+    }
+
+    const size_t count   = min((size_t)length, room);
+    const uint8_t* start = this->_print_buffer + this->_print_length;
+    this->_print_length += count;
+
+    if (!this->_print_buffering) {
+        // Nothing was staged before: the rest is this output's own tail
+        this->flushPrint();
+        const size_t dropped = this->_print_length;
+        this->_print_length  = 0;
+        return count - dropped;
+    }
+
+    if (this->_print_length == BT_PRINT_BUFFER_SIZE || memchr(start, '\n', count) != NULL)
+        this->flushPrint();
+
+    return count;
+}
+
+/**
+ * Print buffering gathers print()/printf()/write() output and sends it as
+ * one bulk write per line, when the staging buffer fills, on `flush()` or
+ * at the next `poll()`, so output without a line end waits for one of
+ * those. Off, the default, every write goes out at once.
+ */
+void Bluetooth::setPrintBuffering(bool enabled)
+{
+    this->flushPrint();
+    this->_print_buffering = enabled;
+}
+
+/**
+ * Hands the staged bytes to `sendBulk()` in one go. What the TX queue
+ * cannot take stays staged. Returns `true` once nothing is left.
+ */
+bool Bluetooth::flushPrint()
+{
+    if (this->_print_length == 0)
+        return true;
+
+    size_t sent = this->sendBulk(this->_print_buffer, this->_print_length);
+    this->_print_length -= sent;
+    memmove(this->_print_buffer, this->_print_buffer + sent, this->_print_length);
+    return this->_print_length == 0;
+}
+
+/**
+ * Unstaged bulk write.
+ *
+ * When the data can go out at once (see `txReady()`), non-BLE links hand it
+ * all to the Uart; BLE links take as many tokens as are available and hand
+ * that chunk over straight from `buffer`. The rest is queued for poll().
+ * Returns how much was accepted, which is less than `size` only when the
+ * queue is full.
+ */
+size_t Bluetooth::sendBulk(const uint8_t* buffer, size_t size)
+{
+    size_t accepted = 0;
+
+    if (this->txReady()) {
+        if (!using_le_device) {
+            BT_STAT(this->_stats.tx_bytes += size);
+            return this->serial->write(buffer, size);
+        }
+
+        int room      = this->serial->availableForWrite();
+        size_t wanted = min(size, (size_t)(room > 0 ? room : 0));
+        size_t count  = this->_bucket.take_tokens(wanted);
+        BT_STAT(this->_stats.tokenWait(count < wanted, millis()));
+
+        if (count > 0)
+            accepted = this->serial->write(buffer, count);
+        BT_STAT(this->_stats.tx_bytes += accepted);
+    }
+
+    accepted += this->_tx.write(buffer + accepted, size - accepted);
+    return accepted;
+}
+
+/**
+ * Whether data may go to the Uart right away: nothing queued ahead of it,
+ * no command in flight or waiting to start, the command pin low (also when
+ * raised with `setCmdPin()`) and the module ready. Data handed over in
+ * command mode would go to the AT parser and be lost.
+ */
+bool Bluetooth::txReady()
+{
+    return this->_tx.available() == 0 && this->_cmd_state == CMD_IDLE && !this->_cmd_pin_high
+           && this->_power_state == POWER_READY && this->oldestCommand(COMMAND_QUEUED) == NULL;
+}
+
+/**
+ * Hands queued bytes to the Uart, as many as there are tokens and room in
+ * its TX buffer. Held while a command is in flight or the command pin is high.
+ */
+size_t Bluetooth::drainTx()
+{
+    if (this->_tx.available() == 0 || this->_cmd_state != CMD_IDLE || this->_cmd_pin_high
+        || this->_power_state != POWER_READY)
+        return 0;
+
+    int room     = this->serial->availableForWrite();
+    size_t count = min(this->_tx.available(), (size_t)(room > 0 ? room : 0));
+
+    if (this->using_le_device) {
+        size_t tokens = this->_bucket.take_tokens(count);
+        BT_STAT(this->_stats.tokenWait(tokens < count, millis()));
+        count = tokens;
+    }
+
+    size_t sent = 0;
+    while (sent < count) {
+        const uint8_t* data;
+        size_t chunk = min(this->_tx.peekContiguous(&data), count - sent);
+
+        this->serial->write(data, chunk);
+        this->_tx.consume(chunk);
+        sent += chunk;
+    }
+    BT_STAT(this->_stats.tx_bytes += sent);
+
+    return sent;
+}
+
+size_t Bluetooth::txQueued()
+{
+    return this->_tx.available() + this->_print_length;
+}
+
+/**
+ * Drives the TX queue until it is empty or `timeout` ms have passed.
+ * Returns `true` if everything was handed to the Uart.
+ */
+bool Bluetooth::flushTx(unsigned long timeout)
+{
+    const unsigned long init_time = millis();
+
+    while (this->txQueued() > 0 && millis() - init_time < timeout)
+        this->poll();
+
+    return this->txQueued() == 0;
+}
+
+/**
+ * Pacing of BLE devices (`using_le_device`): bursts of up to `bucket_size`
+ * bytes, then one byte every `refill_ms`. BT_BUCKET_SIZE and
+ * BT_BUCKET_REFILL_MS until changed; `./bench linkSweep` helps pick them.
+ */
+void Bluetooth::setRateLimit(uint32_t bucket_size, uint32_t refill_ms)
+{
+    this->_bucket = Bucket(bucket_size, max(refill_ms, (uint32_t)1));
+
+    if (this->_pacing_mode == PACING_ADAPTIVE) {
+        this->_fixed_rate = this->_bucket.rate();
+        this->_pacing.reset(this->_fixed_rate);
+        this->_bucket.set_rate(this->_pacing.rate());
+    }
+}
+
+/**
+ * PACING_ADAPTIVE starts from the current rate and follows
+ * `reportDelivered()`/`reportLoss()` from then on, between
+ * BT_PACING_MIN_RATE and BT_PACING_MAX_RATE. PACING_FIXED goes back to the
+ * rate it started from. The burst size stays as set with `setRateLimit()`.
+ */
+void Bluetooth::setPacingMode(PacingMode mode)
+{
+    if (mode == this->_pacing_mode)
+        return;
+
+    if (mode == PACING_ADAPTIVE) {
+        this->_fixed_rate = this->_bucket.rate();
+        this->_pacing.reset(this->_fixed_rate);
+        this->_bucket.set_rate(this->_pacing.rate());
+    } else {
+        this->_bucket.set_rate(this->_fixed_rate);
+    }
+
+    this->_pacing_mode = mode;
+}
+
+/**
+ * The peer acknowledged data sent at the current rate: raise it by
+ * BT_PACING_STEP. Only used with PACING_ADAPTIVE.
+ */
+void Bluetooth::reportDelivered()
+{
+    if (this->_pacing_mode != PACING_ADAPTIVE)
+        return;
+
+    this->_pacing.delivered();
+    this->_bucket.set_rate(this->_pacing.rate());
+}
+
+/**
+ * The peer missed data (no acknowledgement, a checksum failure...): halve
+ * the rate. Only used with PACING_ADAPTIVE.
+ */
+void Bluetooth::reportLoss()
+{
+    if (this->_pacing_mode != PACING_ADAPTIVE)
+        return;
+
+    this->_pacing.lost();
+    this->_bucket.set_rate(this->_pacing.rate());
+}
+
+/**
+ * Bytes/s BLE data is paced at.
+ */
+uint32_t Bluetooth::pacingRate()
+{
+    return this->_bucket.rate();
+}
+
+/**
+ * Rate changes kept in PACING_ADAPTIVE mode, up to BT_PACING_HISTORY.
+ */
+uint8_t Bluetooth::pacingHistoryCount()
+{
+    return this->_pacing.historyCount();
+}
+
+/**
+ * `index` 0 is the oldest change kept.
+ */
+PacingSample Bluetooth::pacingHistory(uint8_t index)
+{
+    return this->_pacing.history(index);
+}
+
+/**
+ * Like Stream::readBytes(), served from the RX buffer.
+ * Gives up after the stream timeout passes without new data.
+ */
 size_t Bluetooth::readBytes(char* buffer, size_t length)
 {
-    size_t recv = this->serial->readBytes(buffer, length);
-    this->handleConnectionURC(buffer);
-    return recv;
+    size_t recvd             = 0;
+    unsigned long last_recvd = millis();
+
+    while (recvd < length) {
+        this->drainRx();
+
+        size_t chunk = this->_rx.read((uint8_t*)buffer + recvd, length - recvd);
+        recvd += chunk;
+
+        if (chunk > 0)
+            last_recvd = millis();
+        else if (millis() - last_recvd >= this->_timeout)
+            break;
+    }
+
+    return recvd;
 }
 
 
 #endif
+
+/**
+ * Switch the data stream to binary frames (see frame_codec.hpp).
+ *
+ * From then on `poll()` feeds received data to `decoder`, which writes into
+ * the caller's buffer, and hands every valid frame to `callback`. Corrupt
+ * frames are dropped and counted by the decoder. Pass NULL to go back to
+ * reading the stream directly.
+ */
+void Bluetooth::setFrameHandler(FrameDecoder* decoder, FrameCallback callback, void* ctx)
+{
+    this->_frame_decoder  = decoder;
+    this->_frame_callback = callback;
+    this->_frame_ctx      = ctx;
+
+    if (decoder != NULL)
+        decoder->reset();
+}
+
+/**
+ * Feeds the RX buffer to the frame decoder, straight from the buffer and
+ * one byte at a time. Left alone while a command is reading replies.
+ * A running transfer takes the stream over for its acknowledgements.
+ */
+void Bluetooth::stepFrames()
+{
+    for (;;) {
+        const bool transfer   = this->transferActive();
+        FrameDecoder* decoder = transfer ? this->_transfer->decoder() : this->_frame_decoder;
+
+        if (decoder == NULL || this->_cmd_state != CMD_IDLE)
+            return;
+
+        const uint8_t* data;
+        size_t length      = this->_rx.peekContiguous(&data);
+        size_t used        = 0;
+        FrameStatus status = FRAME_PENDING;
+
+        if (length == 0)
+            return;
+
+        while (used < length && status == FRAME_PENDING)
+            status = decoder->feed(data[used++]);
+
+        this->_rx.consume(used);
+
+        if (status != FRAME_READY)
+            continue;
+
+        if (transfer)
+            this->_transfer->onFrame(decoder->data(), decoder->length(), millis());
+        else if (this->_frame_callback != NULL)
+            this->_frame_callback(this, decoder->data(), decoder->length(), this->_frame_ctx);
+    }
+}
+
+/**
+ * Send `data` as one frame. Returns `false` if it was not accepted whole;
+ * for BLE devices nothing is written unless the whole frame fits the TX queue.
+ */
+bool Bluetooth::sendFrame(const uint8_t* data, size_t length)
+{
+    if (this->using_le_device && (size_t)this->availableForWrite() < FrameEncoder::maxLength(length))
+        return false;
+
+    return FrameEncoder::write(*this, data, length) > 0 && this->flushPrint();
+}
+
+/**
+ * Encode `data` as one frame into the TX queue, for `poll()` to send.
+ * Never waits: returns `false`, with nothing queued, unless the whole
+ * frame fits.
+ */
+bool Bluetooth::queueFrame(const uint8_t* data, size_t length)
+{
+    struct TxSink {
+            RingBuffer<BT_TX_BUFFER_SIZE>& tx;
+
+            bool write(const uint8_t* data, size_t count)
+            {
+                return tx.write(data, count) == count;
+            }
+    };
+
+    if (!this->flushPrint() || this->_tx.free() < FrameEncoder::maxLength(length))
+        return false;
+
+    TxSink sink = { this->_tx };
+    return FrameEncoder::encode(sink, data, length);
+}
+
+/**
+ * Send `size` bytes read from `reader` to a BlobReceiver on the peer (see
+ * blob_transfer.hpp), driven by `poll()`. A disconnect pauses the transfer,
+ * the next connection resumes it. `offset` resumes an earlier transfer,
+ * e.g. from `transferOffset()` saved before a restart.
+ *
+ * The stream belongs to the transfer until it is done, failed or cancelled;
+ * a frame handler set with `setFrameHandler()` is not fed meanwhile.
+ */
+void Bluetooth::beginTransfer(BlobSender* sender, BlobReader reader, uint32_t size, void* ctx, uint32_t offset)
+{
+    this->_transfer = sender;
+    sender->begin(reader, ctx, size, offset);
+}
+
+TransferStatus Bluetooth::transferStatus()
+{
+    return this->_transfer != NULL ? this->_transfer->status() : TRANSFER_IDLE;
+}
+
+/**
+ * Bytes the receiver has acknowledged.
+ */
+uint32_t Bluetooth::transferOffset()
+{
+    return this->_transfer != NULL ? this->_transfer->offset() : 0;
+}
+
+void Bluetooth::cancelTransfer()
+{
+    if (this->_transfer != NULL)
+        this->_transfer->cancel();
+}
+
+bool Bluetooth::transferActive()
+{
+    return this->_transfer != NULL && this->_transfer->active();
+}
+
+/**
+ * Awaitable command, see bt_flow.hpp: submitted now, over once it has
+ * completed. One that could not be submitted is over at once, with
+ * COMMAND_UNKNOWN.
+ */
+BtCommandWait Bluetooth::command(AtCommand cmd, const char* arg, uint32_t timeout)
+{
+    BtCommandWait wait = {};
+    this->initWait(&wait, WAIT_COMMAND, timeout);
+    wait.handle = this->submitCommand(cmd, arg, timeout);
+    return wait;
+}
+
+BtCommandWait Bluetooth::command(const char* cmd, const char* arg, uint32_t timeout)
+{
+    BtCommandWait wait = {};
+    this->initWait(&wait, WAIT_COMMAND, timeout);
+    wait.handle = this->submitCommand(cmd, arg, timeout);
+    return wait;
+}
+
+/**
+ * Awaitable `waitForConnection()`: over once connected, yielding `true`,
+ * or after `timeout` ms, yielding `false`.
+ */
+BtConnectWait Bluetooth::connected(unsigned long timeout)
+{
+    BtConnectWait wait = {};
+    this->initWait(&wait, WAIT_CONNECTED, timeout);
+    return wait;
+}
+
+/**
+ * Awaitable delay().
+ */
+BtSleepWait Bluetooth::sleep(unsigned long ms)
+{
+    BtSleepWait wait = {};
+    this->initWait(&wait, WAIT_TIME, ms);
+    return wait;
+}
+
+/**
+ * Flows waiting to be resumed by `poll()`.
+ */
+uint8_t Bluetooth::flowsWaiting()
+{
+    return this->_scheduler.count();
+}
+
+void Bluetooth::initWait(BtWait* wait, BtWaitKind kind, unsigned long timeout)
+{
+    wait->scheduler = &this->_scheduler;
+    wait->kind      = kind;
+    wait->handle    = -1;
+    wait->since     = millis();
+    wait->timeout   = timeout;
+}
+
+/**
+ * Tells the scheduler whether `wait` is over, with its outcome filled in.
+ */
+bool Bluetooth::flowReady(void* owner, BtWait* wait)
+{
+    Bluetooth* bt = (Bluetooth*)owner;
+
+    switch (wait->kind) {
+        case WAIT_COMMAND: {
+            CommandStatus status = bt->commandStatus(wait->handle);
+            if (status == COMMAND_QUEUED || status == COMMAND_RUNNING)
+                return false;
+
+            const char* response = bt->commandResponse(wait->handle);
+            wait->reply.status   = status;
+            wait->reply.response = response != NULL ? response : "";
+            return true;
+        }
+
+        case WAIT_CONNECTED:
+            wait->connected = bt->isConnected();
+            return wait->connected || millis() - wait->since >= wait->timeout;
+
+        default:
+            return millis() - wait->since >= wait->timeout;
+    }
+}
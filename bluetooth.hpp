@@ -7,6 +7,17 @@
 #if __has_include(<SoftwareSerial.h>)
 #include <SoftwareSerial.h>
 #endif
+#include "blob_transfer.hpp"
+#include "bt_flow.hpp"
+#include "bt_stats.hpp"
+#include "bucket.hpp"
+#include "frame_codec.hpp"
+#include "line_assembler.hpp"
+#include "pacing_control.hpp"
+#include "response_parser.hpp"
+#include "ring_buffer.hpp"
+#include "spsc_queue.hpp"
+#include "urc_scanner.hpp"
 
 
 class BT_Base : public Stream
@@ -293,6 +304,106 @@ class BT_Wrapper : public BT_Base
         };
 };
 
+/**
+ * Compile-time counterpart of BT_Wrapper.
+ *
+ * Exposes the same API over `Bluetooth`, `SoftwareSerial` or a plain `Uart`
+ * but forwards every call directly to `C`, so calls inline and no vtable is
+ * emitted. Write application code as a template over the wrapper type, e.g.
+ * `template <class BT> void report(BT& bt)`, instead of taking a `BT_Base&`.
+ * Use BT_Wrapper when the device has to be chosen at runtime.
+ */
+template <class C>
+class BT_Static
+{
+    private:
+        C* m_impl;
+
+    public:
+        BT_Static(C* impl) : m_impl(impl) {}
+
+        C* impl()
+        {
+            return m_impl;
+        }
+
+        void begin(unsigned long baudRate)
+        {
+            m_impl->begin(baudRate);
+        };
+
+        void begin(unsigned long baudrate, uint16_t config)
+        {
+            m_impl->begin(baudrate, config);
+        };
+
+        void end()
+        {
+            m_impl->end();
+        };
+
+        int available()
+        {
+            return m_impl->available();
+        };
+
+        int availableForWrite()
+        {
+            return m_impl->availableForWrite();
+        };
+
+        int peek()
+        {
+            return m_impl->peek();
+        };
+
+        int read()
+        {
+            return m_impl->read();
+        };
+
+        void flush()
+        {
+            m_impl->flush();
+        };
+
+        size_t readBytesUntil(char terminator, char* buffer, size_t length)
+        {
+            return m_impl->readBytesUntil(terminator, buffer, length);
+        };
+
+        size_t readBytes(char* buffer, size_t length)
+        {
+            return m_impl->readBytes(buffer, length);
+        };
+
+        void setTimeout(long timeout)
+        {
+            m_impl->setTimeout(timeout);
+        };
+
+        /**
+         * write/print/println forward to whatever overloads `C` provides.
+         */
+        template <class... Args>
+        size_t write(const Args&... args)
+        {
+            return m_impl->write(args...);
+        };
+
+        template <class... Args>
+        size_t print(const Args&... args)
+        {
+            return m_impl->print(args...);
+        };
+
+        template <class... Args>
+        size_t println(const Args&... args)
+        {
+            return m_impl->println(args...);
+        };
+};
+
 #ifdef SoftwareSerial_h
 class Bluetooth : public SoftwareSerial
 {
@@ -342,14 +453,407 @@ class Bluetooth : public SoftwareSerial
 #endif
 
 #ifndef SoftwareSerial_h
+
+#ifndef BT_COMMAND_SLOTS
+#define BT_COMMAND_SLOTS 4
+#endif
+
+// Argument of a table command, or a whole free-form command
+#ifndef BT_COMMAND_LENGTH
+#define BT_COMMAND_LENGTH 32
+#endif
+
+#ifndef BT_RESPONSE_LENGTH
+#define BT_RESPONSE_LENGTH 48
+#endif
+
+// Longest device name accepted by `applyConfig()`
+#ifndef BT_NAME_LENGTH
+#define BT_NAME_LENGTH 18
+#endif
+
+#ifndef BT_PIPELINE_DEPTH
+#define BT_PIPELINE_DEPTH BT_COMMAND_SLOTS
+#endif
+
+#ifndef BT_RX_BUFFER_SIZE
+#define BT_RX_BUFFER_SIZE 256
+#endif
+
+#ifndef BT_TX_BUFFER_SIZE
+#define BT_TX_BUFFER_SIZE 256
+#endif
+
+#ifndef BT_LINE_LENGTH
+#define BT_LINE_LENGTH 128
+#endif
+
+// Timeout of awaited commands unless given, ms
+#ifndef BT_AWAIT_TIMEOUT
+#define BT_AWAIT_TIMEOUT 1000
+#endif
+
+// Staging buffer print()/printf() format into, sent one line at a time
+#ifndef BT_PRINT_BUFFER_SIZE
+#define BT_PRINT_BUFFER_SIZE 64
+#endif
+
+#ifndef BT_BUFFER_SIZE
+#define BT_BUFFER_SIZE 128
+#endif
+
+#ifndef BT_URC_LENGTH
+#define BT_URC_LENGTH 32
+#endif
+
+// Optional RX path fed from an interrupt handler, see `isrDrain()`
+#ifndef BT_ISR_RX
+#define BT_ISR_RX 0
+#endif
+
+#ifndef BT_ISR_RX_SIZE
+#define BT_ISR_RX_SIZE 512
+#endif
+
+// Longest wait for a powered module to show it is ready
+#ifndef BT_BOOT_TIMEOUT_MS
+#define BT_BOOT_TIMEOUT_MS 1000
+#endif
+
+// Rate limit for BLE devices: burst size and one token per refill period
+#ifndef BT_BUCKET_SIZE
+#define BT_BUCKET_SIZE 50
+#endif
+
+#ifndef BT_BUCKET_REFILL_MS
+#define BT_BUCKET_REFILL_MS 1
+#endif
+
+// PACING_ADAPTIVE: bounds and additive step in bytes/s, rate changes kept
+#ifndef BT_PACING_MIN_RATE
+#define BT_PACING_MIN_RATE 100
+#endif
+
+#ifndef BT_PACING_MAX_RATE
+#define BT_PACING_MAX_RATE 8000
+#endif
+
+#ifndef BT_PACING_STEP
+#define BT_PACING_STEP 50
+#endif
+
+#ifndef BT_PACING_HISTORY
+#define BT_PACING_HISTORY 16
+#endif
+
+enum CommandStatus {
+    COMMAND_UNKNOWN, // handle was never issued or its slot has been reused
+    COMMAND_QUEUED,
+    COMMAND_RUNNING,
+    COMMAND_DONE,    // module answered
+    COMMAND_ERROR,   // module answered with "ERROR..."
+    COMMAND_TIMEOUT, // no answer in time
+};
+
+/**
+ * Module settings kept in the configuration cache.
+ */
+enum ConfigItem {
+    CONFIG_VERSION,
+    CONFIG_NAME,
+    CONFIG_PIN,
+    CONFIG_BAUD,
+    CONFIG_ITEMS,
+};
+
+/**
+ * Settings staged for `Bluetooth::applyConfig()`, which applies only those
+ * that were set. The setters refuse values that do not fit; whether the
+ * module takes them is checked by `Bluetooth::checkConfig()`.
+ */
+struct BluetoothConfig {
+        char name[BT_NAME_LENGTH + 1] = {};
+        char pin[5]                   = {};
+        long baud                     = 0;
+        uint8_t staged                = 0; // 1 << ConfigItem
+
+        bool setName(const char* value)
+        {
+            if (strlen(value) > BT_NAME_LENGTH)
+                return false;
+
+            strcpy(this->name, value);
+            this->staged |= 1 << CONFIG_NAME;
+            return true;
+        }
+
+        bool setPin(const char* value)
+        {
+            if (strlen(value) >= sizeof(this->pin))
+                return false;
+
+            strcpy(this->pin, value);
+            this->staged |= 1 << CONFIG_PIN;
+            return true;
+        }
+
+        void setBaud(long value)
+        {
+            this->baud = value;
+            this->staged |= 1 << CONFIG_BAUD;
+        }
+
+        bool has(ConfigItem item) const
+        {
+            return this->staged & (1 << item);
+        }
+};
+
+enum ApplyStatus {
+    APPLY_DONE,
+    APPLY_INVALID,  // nothing staged, or a value the module refuses; nothing sent
+    APPLY_FAILED,   // the module refused a setting or did not answer, it was not reset
+    APPLY_MISMATCH, // reset, but the module reads back something else
+};
+
+/**
+ * How to wait for the module to follow the command pin.
+ */
+enum SettleMode {
+    SETTLE_FIXED,    // always CMD_SETTLE_MS
+    SETTLE_ADAPTIVE, // learn the time per baud rate, bounded by CMD_SETTLE_MS
+};
+
+enum PowerState {
+    POWER_OFF,
+    POWER_BOOTING, // powered, not answering yet
+    POWER_READY,
+};
+
+/**
+ * How BLE devices (`using_le_device`) are paced.
+ */
+enum PacingMode {
+    PACING_FIXED,    // the rate set with setRateLimit()
+    PACING_ADAPTIVE, // AIMD on the deliveries and losses the application reports
+};
+
+class Bluetooth;
+
+/**
+ * Called from `poll()` once a command has completed and the module is back in data mode.
+ * `response` is the NUL-terminated reply line without its line ending.
+ */
+typedef void (*CommandCallback)(Bluetooth* bt, int handle, CommandStatus status, const char* response, void* ctx);
+
+/**
+ * Called from `poll()` for every frame that passed its CRC.
+ * `data` is only valid during the call.
+ */
+typedef void (*FrameCallback)(Bluetooth* bt, const uint8_t* data, size_t length, void* ctx);
+
+/**
+ * Called from `poll()` for every completed line. `line` is NUL-terminated,
+ * without its line ending, and only valid during the call. `overflow` is set
+ * when the line was longer than BT_LINE_LENGTH and has been cut.
+ */
+typedef void (*LineCallback)(Bluetooth* bt, const char* line, size_t length, bool overflow, void* ctx);
+
+/**
+ * Called from `poll()` with a complete URC line (NUL-terminated, without its
+ * line ending, cut at BT_URC_LENGTH), only valid during the call.
+ */
+typedef void (*UrcCallback)(Bluetooth* bt, const char* line, void* ctx);
+
+/**
+ * Commands of the module's table (names kept in flash), in the order of
+ * the BT_STATS latency histograms.
+ */
+enum AtCommand {
+    AT_VERSION,
+    AT_NAME,
+    AT_PIN,
+    AT_BAUD,
+    AT_RESET,
+    AT_DEFAULT,
+    AT_DISC,
+    AT_COMMANDS,
+    AT_TEXT = AT_COMMANDS, // free-form command, held whole in the slot
+};
+
+struct BluetoothCommand {
+        uint8_t command; // AtCommand, `text` is then only the argument
+        int handle;
+        CommandStatus status;
+        CommandStatus result;
+        uint32_t timeout;
+        unsigned long sent_at;
+        CommandCallback callback;
+        void* ctx;
+        char text[BT_COMMAND_LENGTH + 1];
+        char response[BT_RESPONSE_LENGTH + 1];
+        uint8_t response_length;
+#if BT_STATS
+        unsigned long submitted_at;
+#endif
+};
+
 class Bluetooth : public Stream
 {
     private:
-        bool _is_connected  = false;
-        bool _is_connecting = false;
+        enum CommandState {
+            CMD_IDLE,
+            CMD_ENTERING,
+            CMD_ACTIVE,
+            CMD_EXITING,
+        };
+
+        enum UrcLineState {
+            URC_LINE_SCAN,    // may still be a URC, bytes held back
+            URC_LINE_MATCHED, // a known URC, stripped up to its line end
+            URC_LINE_UNKNOWN, // unsolicited but unknown, passed on and reported
+            URC_LINE_PASS,    // data, or a URC seen while not stripping
+        };
+
+        enum UrcEvent {
+            URC_EVENT_CONNECT,
+            URC_EVENT_DISCONNECT,
+            URC_EVENT_UNKNOWN,
+            URC_EVENTS,
+        };
+
+        bool _is_connected       = false;
+        bool _is_connecting      = false;
+        bool _reported_connected = false;
+
+        RingBuffer<BT_RX_BUFFER_SIZE> _rx;
+#if BT_ISR_RX
+        SpscQueue<BT_ISR_RX_SIZE> _isr_rx;
+#endif
+        UrcScanner _urc;
+        UrcLineState _urc_state                = URC_LINE_SCAN;
+        UrcType _urc_type                      = URC_NONE;
+        char _urc_line[BT_URC_LENGTH + 1]      = {};
+        uint8_t _urc_length                    = 0;
+        uint8_t _urc_held                      = 0;
+        unsigned long _urc_held_at             = 0;
+        bool _urc_connecting                   = false;
+        UrcCallback _urc_callbacks[URC_EVENTS] = {};
+        void* _urc_ctx[URC_EVENTS]             = {};
+        bool _cmd_pin_high                     = false;
+        uint32_t _rx_overflows                 = 0;
+
+        RingBuffer<BT_TX_BUFFER_SIZE> _tx;
+        uint8_t _print_buffer[BT_PRINT_BUFFER_SIZE + 1]; // + 1 for the NUL vsnprintf() ends with
+        uint16_t _print_length  = 0;
+        bool _print_buffering   = false;
+        Bucket _bucket          = Bucket(BT_BUCKET_SIZE, BT_BUCKET_REFILL_MS);
+        PacingMode _pacing_mode = PACING_FIXED;
+        uint32_t _fixed_rate    = 0;
+        PacingControl<BT_PACING_HISTORY> _pacing
+            = PacingControl<BT_PACING_HISTORY>(1000 / BT_BUCKET_REFILL_MS,
+                                               BT_PACING_MIN_RATE,
+                                               BT_PACING_MAX_RATE,
+                                               BT_PACING_STEP,
+                                               1,
+                                               2);
+
+        char _buffer[BT_BUFFER_SIZE + 1];
+
+        BluetoothCommand _commands[BT_COMMAND_SLOTS] = {};
+        CommandState _cmd_state                      = CMD_IDLE;
+        unsigned long _cmd_since                     = 0;
+        int _next_handle                             = 1;
+        bool _session                                = false;
+        bool _session_closing                        = false;
+        bool _reset_pending                          = false;
+        uint8_t _pipeline_depth                      = BT_PIPELINE_DEPTH;
+
+        long _baud                   = 0;
+        SettleMode _settle_mode      = SETTLE_ADAPTIVE;
+        uint16_t _settle_ms[6]       = {};
+        bool _probe_pending          = false;
+        unsigned long _probe_sent_at = 0;
+        uint8_t _probe_reply         = 0;
+
+        PowerState _power_state    = POWER_READY;
+        unsigned long _power_since = 0;
+        unsigned long _wake_ms     = 0;
+        bool _duty_cycling         = false;
+        bool _duty_off             = false;
+        bool _duty_stay_connected  = true;
+        uint32_t _duty_on_ms       = 0;
+        uint32_t _duty_off_ms      = 0;
+        unsigned long _duty_since  = 0;
+
+        char _config[CONFIG_ITEMS][BT_RESPONSE_LENGTH + 1] = {};
+        uint8_t _config_valid                              = 0;
+        uint32_t _config_hits                              = 0;
+        uint32_t _config_misses                            = 0;
+
+        FrameDecoder* _frame_decoder  = NULL;
+        FrameCallback _frame_callback = NULL;
+        void* _frame_ctx              = NULL;
+        BlobSender* _transfer         = NULL;
+        BtScheduler _scheduler        = BtScheduler(Bluetooth::flowReady, this);
+
+        LineAssembler<BT_LINE_LENGTH> _line;
+        LineStatus _line_status     = LINE_PENDING;
+        LineCallback _line_callback = NULL;
+        void* _line_ctx             = NULL;
+
+#if BT_STATS
+        BluetoothStats _stats;
+#endif
 
         void setCmdPin(int state);
-        void handleConnectionURC(const char* str);
+        size_t drainRx();
+        void clearRx();
+        void pushRx(uint8_t value);
+        void scanUrc(char c);
+        void releaseUrc();
+        void appendUrcLine(char c);
+        void endUrcLine();
+        void resetUrc();
+        void writeCmdPin(int state);
+        size_t drainTx();
+        bool txReady();
+        size_t sendBulk(const uint8_t* buffer, size_t size);
+        bool flushPrint();
+        void handleURC(UrcType urc);
+
+        int queueCommand(AtCommand command,
+                         const char* cmd,
+                         const char* arg,
+                         uint32_t timeout,
+                         CommandCallback callback,
+                         void* ctx);
+        CommandStatus waitCommand(int handle, char* response, int length);
+        size_t sendAt(uint8_t command, const char* text);
+        BluetoothCommand* findCommand(int handle);
+        BluetoothCommand* oldestCommand(CommandStatus status);
+        void cutPower();
+        bool powerHeld();
+        void stepPower();
+        bool stepBoot();
+        void startBoot();
+        void stepCommands();
+        bool stepSettle();
+        bool probeBaud(long baud, char* reply, size_t length);
+        bool stepActive();
+        bool collectResponse(BluetoothCommand* command);
+        void stepFrames();
+        bool transferActive();
+        static bool flowReady(void* owner, BtWait* wait);
+        void initWait(BtWait* wait, BtWaitKind kind, unsigned long timeout);
+        bool assembleLine();
+        void stepLines();
+        void finishCommand(BluetoothCommand* command);
+        void finishCommands();
+
+        void queryConfig(ConfigItem item, char* buffer, int length);
+        bool parseConfig(ConfigItem item, ModuleResponse* response);
+        void storeConfig(ConfigItem item, const char* prefix, const char* value);
 
     public:
         Uart* serial;
@@ -373,31 +877,114 @@ class Bluetooth : public Stream
 
         void powerOn();
         void powerOff();
+        void requestPowerOn();
+        PowerState powerState();
+        unsigned long wakeLatency();
+        void setDutyCycle(uint32_t on_ms, uint32_t off_ms, bool stay_awake_connected = true);
+        void stopDutyCycle();
 
         void setBaud(long baud, uint32_t stop_bits, uint32_t parity);
         void setBaud(long baud);
         unsigned long findBaud();
+        unsigned long discoverBaud(long hint = 0);
 
         size_t poll();
         bool isConnected();
         bool waitForConnection(unsigned long timeout);
 
+        void printClientMAC(bool new_line = false);
+        bool handlNewConnection();
+
         int readLine(char* buffer, int length);
         void sendCommand(char* cmd, uint32_t timeout);
 
+        void onConnect(UrcCallback callback, void* ctx = NULL);
+        void onDisconnect(UrcCallback callback, void* ctx = NULL);
+        void onUnknownUrc(UrcCallback callback, void* ctx = NULL);
+
+        int pollLine(char* buffer, int length, bool* overflow = NULL);
+        void setLineHandler(LineCallback callback, void* ctx = NULL);
+        uint32_t lineOverflows();
+
+#if BT_STATS
+        const BluetoothStats& stats()
+        {
+            return this->_stats;
+        }
+#endif
+
+        /**
+         * Write the counters and latency histograms to `out`.
+         * Prints nothing unless built with BT_STATS=1.
+         */
+        void dumpStats(Print& out)
+        {
+#if BT_STATS
+            this->_stats.dump(out);
+#else
+            (void)out;
+#endif
+        }
+
+        int submitCommand(const char* cmd,
+                          const char* arg,
+                          uint32_t timeout,
+                          CommandCallback callback = NULL,
+                          void* ctx                = NULL);
+        int submitCommand(AtCommand cmd,
+                          const char* arg,
+                          uint32_t timeout,
+                          CommandCallback callback = NULL,
+                          void* ctx                = NULL);
+        CommandStatus commandStatus(int handle);
+        const char* commandResponse(int handle);
+        bool commandPending();
+        CommandStatus runCommand(const char* cmd,
+                                 const char* arg,
+                                 uint32_t timeout,
+                                 char* response = NULL,
+                                 int length     = 0);
+        CommandStatus runCommand(AtCommand cmd,
+                                 const char* arg,
+                                 uint32_t timeout,
+                                 char* response = NULL,
+                                 int length     = 0);
+
+        void beginCommandSession();
+        void endCommandSession();
+        bool inCommandSession();
+        void setPipelineDepth(uint8_t depth);
+
+        void setSettleMode(SettleMode mode);
+        unsigned long settleTime(long baud);
+        unsigned long learnedSettleTime(long baud);
+
         // void getName();
         void getVersion(char* buffer, int length);
         void getBauds(char* buffer, int length);
         void getName(char* buffer, int length);
         void getPin(char* buffer, int length);
 
+        BtStringView versionView();
+        BtStringView nameView();
+        BtStringView pinView();
+        long moduleBaud();
+
         bool setName(char* name);
         bool setPin(char* pin);
 
+        bool checkConfig(const BluetoothConfig& config);
+        ApplyStatus applyConfig(const BluetoothConfig& config);
+
         void reset();
         void resetFactory();
         void disconnect();
 
+        void invalidateConfig();
+        void refreshConfig();
+        uint32_t configCacheHits();
+        uint32_t configCacheMisses();
+
         void begin(unsigned long baudRate);
         void begin(unsigned long baudrate, uint16_t config);
         void end();
@@ -410,17 +997,182 @@ class Bluetooth : public Stream
         size_t readBytes(char* buffer, size_t length);
         void setTimeout(long timeout);
 
+        size_t peekBuffer(const uint8_t** data);
+        void consume(size_t length);
+        uint32_t rxOverflows();
+
+#if BT_ISR_RX
+        /**
+         * Producer side of the ISR RX path, for one interrupt context only.
+         * `isrDrain()` moves everything the Uart holds, e.g. from the SERCOM
+         * handler right after the Uart's own:
+         *
+         *     void SERCOM1_Handler() { uart.IrqHandler(); bt.isrDrain(); }
+         *
+         * `poll()` and the reads then take bytes from this queue and never
+         * touch the Uart's RX buffer.
+         */
+        void isrDrain()
+        {
+            while (this->serial->available() > 0)
+                this->_isr_rx.push((uint8_t)this->serial->read());
+        }
+
+        void isrReceive(uint8_t value)
+        {
+            this->_isr_rx.push(value);
+        }
+
+        /**
+         * Bytes lost because the ISR queue was full.
+         */
+        uint32_t isrOverflows()
+        {
+            return this->_isr_rx.overflows();
+        }
+#endif
+
+        size_t txQueued();
+        bool flushTx(unsigned long timeout);
+        void setRateLimit(uint32_t bucket_size, uint32_t refill_ms);
+        void setPacingMode(PacingMode mode);
+        void reportDelivered();
+        void reportLoss();
+        uint32_t pacingRate();
+        uint8_t pacingHistoryCount();
+        PacingSample pacingHistory(uint8_t index);
+
+        void setFrameHandler(FrameDecoder* decoder, FrameCallback callback, void* ctx = NULL);
+        bool sendFrame(const uint8_t* data, size_t length);
+        bool queueFrame(const uint8_t* data, size_t length);
+
+        void beginTransfer(BlobSender* sender, BlobReader reader, uint32_t size, void* ctx = NULL, uint32_t offset = 0);
+        TransferStatus transferStatus();
+        uint32_t transferOffset();
+        void cancelTransfer();
+
+        BtCommandWait command(AtCommand cmd, const char* arg = NULL, uint32_t timeout = BT_AWAIT_TIMEOUT);
+        BtCommandWait command(const char* cmd, const char* arg = NULL, uint32_t timeout = BT_AWAIT_TIMEOUT);
+        BtConnectWait connected(unsigned long timeout);
+        BtSleepWait sleep(unsigned long ms);
+        uint8_t flowsWaiting();
+
         size_t write(const uint8_t value) override;
+        size_t write(const uint8_t* buffer, size_t size) override;
+        size_t printf(const char* format, ...);
+        void setPrintBuffering(bool enabled);
 
         size_t write(char* value, size_t length)
         {
-            return this->serial->write(value, length);
+            return this->write((const uint8_t*)value, length);
         }
 
         using Print::print;
         using Print::println;
         using Print::write;
 };
+
+/**
+ * Scoped command session: command mode is entered once for every command
+ * issued while it lives, and left when it goes out of scope.
+ */
+class BluetoothCommandSession
+{
+    private:
+        Bluetooth& m_bt;
+
+    public:
+        BluetoothCommandSession(Bluetooth& bt) : m_bt(bt)
+        {
+            m_bt.beginCommandSession();
+        }
+
+        ~BluetoothCommandSession()
+        {
+            m_bt.endCommandSession();
+        }
+};
+
+/**
+ * Services up to `N` modules from one loop.
+ *
+ * `poll()` polls every link once, starting from a different one each call so
+ * none is always served last. Since `Bluetooth::poll()` never waits, a link
+ * waiting on a command reply or on its rate limit does not hold up the
+ * others. Use `runCommand()` here instead of on a link to wait for a reply
+ * while keeping every link serviced.
+ */
+template <uint8_t N>
+class BluetoothPoller
+{
+    private:
+        Bluetooth* m_links[N];
+        uint8_t m_count = 0;
+        uint8_t m_next  = 0;
+
+    public:
+        bool add(Bluetooth& bt)
+        {
+            if (m_count == N)
+                return false;
+
+            m_links[m_count++] = &bt;
+            return true;
+        }
+
+        uint8_t count() const
+        {
+            return m_count;
+        }
+
+        Bluetooth& link(uint8_t index)
+        {
+            return *m_links[index];
+        }
+
+        /**
+         * Returns the number of bytes received over all links.
+         */
+        size_t poll()
+        {
+            size_t recvd = 0;
+
+            for (uint8_t i = 0; i < m_count; i++)
+                recvd += m_links[(m_next + i) % m_count]->poll();
+
+            if (m_count > 0)
+                m_next = (m_next + 1) % m_count;
+
+            return recvd;
+        }
+
+        /**
+         * `Bluetooth::runCommand()` on `bt`, polling every link while waiting.
+         */
+        CommandStatus runCommand(Bluetooth& bt,
+                                 const char* cmd,
+                                 const char* arg,
+                                 uint32_t timeout,
+                                 char* response = NULL,
+                                 int length     = 0)
+        {
+            int handle = bt.submitCommand(cmd, arg, timeout);
+
+            if (handle >= 0) {
+                CommandStatus status;
+                while ((status = bt.commandStatus(handle)) == COMMAND_QUEUED || status == COMMAND_RUNNING)
+                    this->poll();
+            }
+
+            if (response != NULL && length > 0) {
+                const char* reply = handle >= 0 ? bt.commandResponse(handle) : "";
+                strncpy(response, reply, length - 1);
+                response[length - 1] = 0;
+            }
+
+            return handle >= 0 ? bt.commandStatus(handle) : COMMAND_UNKNOWN;
+        }
+};
 #endif
 
 
@@ -0,0 +1,338 @@
+#ifndef BT_FLOW_HPP
+#define BT_FLOW_HPP
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/**
+ * Cooperative flows: multi-step sequences (query, set the name, reset,
+ * wait for the peer to come back...) that wait without blocking, so
+ * several of them, on one or several modules, run side by side from the
+ * same loop. A waiting flow is resumed from `poll()` once what it waits
+ * for is over.
+ *
+ * With C++20 coroutines, flows are coroutines returning BtTask:
+ *
+ *     BtTask provision(Bluetooth& bt)
+ *     {
+ *         BtReply reply = co_await bt.command(AT_NAME, "SENSOR-01");
+ *         if (reply.status != COMMAND_DONE)
+ *             co_return;
+ *         co_await bt.command(AT_RESET);
+ *         bool back = co_await bt.connected(10000);
+ *     }
+ *
+ * Elsewhere, or by choice, they are protothreads: a BtFlow whose `run()`
+ * is written between BT_FLOW_BEGIN() and BT_FLOW_END() and waits with
+ * BT_AWAIT(). `run()` returns at every wait and comes back in at the same
+ * BT_AWAIT(), so anything kept across waits has to be a member, not a local.
+ *
+ *     class Provision : public BtFlow
+ *     {
+ *             void run() override
+ *             {
+ *                 BT_FLOW_BEGIN();
+ *                 BT_AWAIT(bt.command(AT_NAME, "SENSOR-01"));
+ *                 if (reply().status != COMMAND_DONE)
+ *                     BT_FLOW_EXIT();
+ *                 BT_AWAIT(bt.command(AT_RESET));
+ *                 BT_AWAIT(bt.connected(10000));
+ *                 BT_FLOW_END();
+ *             }
+ *     };
+ *
+ *     provision.start();
+ */
+
+#ifndef BT_COROUTINES
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define BT_COROUTINES 1
+#else
+#define BT_COROUTINES 0
+#endif
+#endif
+
+#if BT_COROUTINES
+#include <coroutine>
+#endif
+
+enum BtWaitKind {
+    WAIT_COMMAND,
+    WAIT_CONNECTED,
+    WAIT_TIME,
+};
+
+/**
+ * Outcome of an awaited command. `response` points into the command slot
+ * and stays valid until the slot is reused.
+ */
+struct BtReply {
+        uint8_t status; // CommandStatus
+        const char* response;
+};
+
+class BtScheduler;
+
+/**
+ * What a flow waits for, then how it went.
+ */
+struct BtWait {
+        BtScheduler* scheduler;
+        uint8_t kind; // BtWaitKind
+        int handle;   // WAIT_COMMAND
+        unsigned long since;
+        unsigned long timeout; // ms, WAIT_CONNECTED and WAIT_TIME
+
+        BtReply reply;  // WAIT_COMMAND
+        bool connected; // WAIT_CONNECTED: the link came up in time
+
+        // Set by whoever waits: run from `poll()` once the wait is over
+        void (*wake)(BtWait* wait);
+        void* ctx;
+        BtWait* next;
+
+#if BT_COROUTINES
+        bool await_ready();
+        void await_suspend(std::coroutine_handle<> coroutine);
+#endif
+};
+
+/**
+ * The waits of one module, oldest first. `ready` tells whether a wait is
+ * over, and fills in its outcome when it is.
+ */
+class BtScheduler
+{
+    private:
+        bool (*_ready)(void* owner, BtWait* wait);
+        void* _owner;
+
+        BtWait* _head  = NULL;
+        BtWait* _tail  = NULL;
+        bool _running  = false;
+        uint8_t _count = 0;
+
+    public:
+        BtScheduler(bool (*ready)(void* owner, BtWait* wait), void* owner) : _ready(ready), _owner(owner) {}
+
+        bool ready(BtWait* wait)
+        {
+            return this->_ready(this->_owner, wait);
+        }
+
+        void add(BtWait* wait)
+        {
+            wait->next = NULL;
+            if (this->_tail != NULL)
+                this->_tail->next = wait;
+            else
+                this->_head = wait;
+            this->_tail = wait;
+            this->_count++;
+        }
+
+        /**
+         * Wakes every wait that is over. A flow resumed here may wait again;
+         * that wait is checked on the next run. Does nothing when called
+         * from inside a flow.
+         */
+        void run()
+        {
+            if (this->_running || this->_head == NULL)
+                return;
+
+            BtWait* wait   = this->_head;
+            this->_head    = NULL;
+            this->_tail    = NULL;
+            this->_count   = 0;
+            this->_running = true;
+
+            while (wait != NULL) {
+                // `wait` may be gone once woken: it lives in the flow
+                BtWait* next = wait->next;
+
+                if (this->ready(wait))
+                    wait->wake(wait);
+                else
+                    this->add(wait);
+
+                wait = next;
+            }
+
+            this->_running = false;
+        }
+
+        /**
+         * Flows waiting.
+         */
+        uint8_t count() const
+        {
+            return this->_count;
+        }
+};
+
+/**
+ * A protothread flow, see above. `start()` runs it up to its first wait;
+ * once it has ended it can be started again.
+ */
+class BtFlow
+{
+    private:
+        static void wake(BtWait* wait)
+        {
+            ((BtFlow*)wait->ctx)->run();
+        }
+
+    protected:
+        uint16_t _line = 0;
+        bool _running  = false;
+        BtWait _wait   = {};
+
+        /**
+         * `true` when the wait is already over, else it is handed to the
+         * scheduler and the flow returns.
+         */
+        bool await()
+        {
+            if (this->_wait.scheduler->ready(&this->_wait))
+                return true;
+
+            this->_wait.wake = BtFlow::wake;
+            this->_wait.ctx  = this;
+            this->_wait.scheduler->add(&this->_wait);
+            return false;
+        }
+
+        BtReply reply() const
+        {
+            return this->_wait.reply;
+        }
+
+        bool connected() const
+        {
+            return this->_wait.connected;
+        }
+
+    public:
+        virtual ~BtFlow() {}
+
+        virtual void run() = 0;
+
+        void start()
+        {
+            this->_line    = 0;
+            this->_running = true;
+            this->run();
+        }
+
+        bool running() const
+        {
+            return this->_running;
+        }
+};
+
+// Marks the fall into the resume point of BT_AWAIT() as intended
+#if __cplusplus >= 201703L
+#define BT_FALLTHROUGH [[fallthrough]]
+#elif defined(__has_attribute)
+#if __has_attribute(fallthrough)
+#define BT_FALLTHROUGH __attribute__((fallthrough))
+#endif
+#endif
+#ifndef BT_FALLTHROUGH
+#define BT_FALLTHROUGH
+#endif
+
+#define BT_FLOW_BEGIN()     \
+    switch (this->_line) { \
+        case 0:
+
+#define BT_AWAIT(wait)            \
+    do {                          \
+        this->_wait = (wait);     \
+        this->_line = __LINE__;   \
+        BT_FALLTHROUGH;           \
+        case __LINE__:            \
+            if (!this->await())   \
+                return;           \
+    } while (0)
+
+#define BT_FLOW_EXIT()          \
+    do {                        \
+        this->_running = false; \
+        this->_line    = 0;     \
+        return;                 \
+    } while (0)
+
+#define BT_FLOW_END() \
+    }                 \
+    BT_FLOW_EXIT()
+
+#if BT_COROUTINES
+inline bool BtWait::await_ready()
+{
+    return this->scheduler->ready(this);
+}
+
+inline void BtWait::await_suspend(std::coroutine_handle<> coroutine)
+{
+    this->wake = [](BtWait* wait) { std::coroutine_handle<>::from_address(wait->ctx).resume(); };
+    this->ctx  = coroutine.address();
+    this->scheduler->add(this);
+}
+
+struct BtCommandWait : public BtWait {
+        BtReply await_resume()
+        {
+            return this->reply;
+        }
+};
+
+struct BtConnectWait : public BtWait {
+        bool await_resume()
+        {
+            return this->connected;
+        }
+};
+
+struct BtSleepWait : public BtWait {
+        void await_resume() {}
+};
+
+/**
+ * Return type of a coroutine flow. It starts at once and runs until its
+ * first wait; the frame is allocated by `new` and freed when it ends.
+ */
+struct BtTask {
+        struct promise_type {
+                BtTask get_return_object()
+                {
+                    return BtTask();
+                }
+
+                std::suspend_never initial_suspend() noexcept
+                {
+                    return {};
+                }
+
+                std::suspend_never final_suspend() noexcept
+                {
+                    return {};
+                }
+
+                void return_void() {}
+
+                void unhandled_exception()
+                {
+                    abort();
+                }
+        };
+};
+#else
+typedef BtWait BtCommandWait;
+typedef BtWait BtConnectWait;
+typedef BtWait BtSleepWait;
+#endif
+
+#endif
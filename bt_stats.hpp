@@ -0,0 +1,217 @@
+#ifndef BT_STATS_HPP
+#define BT_STATS_HPP
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "urc_scanner.hpp"
+
+/**
+ * Optional driver instrumentation, off unless built with BT_STATS=1.
+ *
+ * Disabled, every BT_STAT() statement and the counters themselves compile
+ * away. Enabled, it is a fixed block of counters inside each Bluetooth
+ * instance: no heap, no locks, a few adds per event.
+ */
+#ifndef BT_STATS
+#define BT_STATS 0
+#endif
+
+#if BT_STATS
+#define BT_STAT(statement)                                                                                             \
+    do {                                                                                                               \
+        statement;                                                                                                     \
+    } while (0)
+#else
+#define BT_STAT(statement)                                                                                             \
+    do {                                                                                                               \
+    } while (0)
+#endif
+
+#if BT_STATS
+
+#define BT_LATENCY_BUCKETS 8
+
+/**
+ * Latencies in milliseconds, counted in fixed buckets:
+ * < 10, < 20, < 50, < 100, < 200, < 500, < 1000 and the rest.
+ */
+struct LatencyHistogram {
+        uint16_t counts[BT_LATENCY_BUCKETS] = {};
+        uint32_t samples                    = 0;
+        uint32_t total_ms                   = 0;
+        uint32_t max_ms                     = 0;
+
+        static uint16_t bound(uint8_t bucket)
+        {
+            static const uint16_t bounds[BT_LATENCY_BUCKETS - 1] = { 10, 20, 50, 100, 200, 500, 1000 };
+            return bounds[bucket];
+        }
+
+        void record(uint32_t ms)
+        {
+            uint8_t bucket = 0;
+            while (bucket < BT_LATENCY_BUCKETS - 1 && ms >= bound(bucket))
+                bucket++;
+
+            if (counts[bucket] < UINT16_MAX)
+                counts[bucket]++;
+
+            samples++;
+            total_ms += ms;
+            max_ms = max(max_ms, ms);
+        }
+
+        void dump(Print& out, const char* name) const
+        {
+            out.print(name);
+            out.print(F(": n="));
+            out.print(samples);
+
+            if (samples == 0) {
+                out.println();
+                return;
+            }
+
+            out.print(F(" avg="));
+            out.print(total_ms / samples);
+            out.print(F("ms max="));
+            out.print(max_ms);
+            out.print(F("ms |"));
+
+            for (uint8_t bucket = 0; bucket < BT_LATENCY_BUCKETS; bucket++) {
+                out.print(' ');
+                if (bucket < BT_LATENCY_BUCKETS - 1) {
+                    out.print('<');
+                    out.print(bound(bucket));
+                } else {
+                    out.print(F(">="));
+                    out.print(bound(bucket - 1));
+                }
+                out.print(':');
+                out.print(counts[bucket]);
+            }
+            out.println();
+        }
+};
+
+enum StatsCommand {
+    STATS_CMD_VERSION,
+    STATS_CMD_NAME,
+    STATS_CMD_PIN,
+    STATS_CMD_BAUD,
+    STATS_CMD_RESET,
+    STATS_CMD_DEFAULT,
+    STATS_CMD_DISC,
+    STATS_CMD_OTHER,
+    STATS_CMD_COUNT,
+};
+
+struct BluetoothStats {
+        uint32_t tx_bytes        = 0;
+        uint32_t rx_bytes        = 0;
+        uint32_t token_wait_ms   = 0; // TX queue held back by the rate limit
+        uint32_t settle_ms       = 0; // waiting for the module to follow the cmd pin
+        uint32_t commands        = 0;
+        uint32_t command_errors  = 0;
+        uint32_t timeouts        = 0;
+        uint32_t urcs[URC_COUNT] = {};
+        uint32_t connects        = 0;
+        uint32_t disconnects     = 0;
+        uint32_t wakes           = 0;
+
+        LatencyHistogram connect_latency;
+        LatencyHistogram wake_latency; // power on until the module answers
+        LatencyHistogram command_latency[STATS_CMD_COUNT];
+
+        unsigned long connecting_since = 0;
+        unsigned long token_wait_since = 0;
+        bool token_waiting             = false;
+
+        static const char* commandName(uint8_t command)
+        {
+            static const char* const names[STATS_CMD_COUNT]
+                = { "VERSION", "NAME", "PIN", "BAUD", "RESET", "DEFAULT", "DISC", "OTHER" };
+            return names[command];
+        }
+
+        /**
+         * Histogram slot of an AT command line, e.g. "AT+NAMEfoo" -> STATS_CMD_NAME.
+         */
+        static StatsCommand classify(const char* text)
+        {
+            if (strncmp(text, "AT+", 3) != 0)
+                return STATS_CMD_OTHER;
+
+            for (uint8_t command = 0; command < STATS_CMD_OTHER; command++) {
+                const char* name = commandName(command);
+                if (strncmp(text + 3, name, strlen(name)) == 0)
+                    return (StatsCommand)command;
+            }
+
+            return STATS_CMD_OTHER;
+        }
+
+        /**
+         * Called whenever the TX queue is offered to the rate limiter, with
+         * whether it had to hold bytes back.
+         */
+        void tokenWait(bool waiting, unsigned long now)
+        {
+            if (waiting && !token_waiting)
+                token_wait_since = now;
+            else if (!waiting && token_waiting)
+                token_wait_ms += now - token_wait_since;
+
+            token_waiting = waiting;
+        }
+
+        void dump(Print& out) const
+        {
+            static const char* const urc_names[URC_COUNT] = { "CONNECTING", "CONNECTED", "DISC" };
+
+            out.print(F("tx bytes: "));
+            out.println(tx_bytes);
+            out.print(F("rx bytes: "));
+            out.println(rx_bytes);
+            out.print(F("token wait ms: "));
+            out.println(token_wait_ms);
+            out.print(F("settle ms: "));
+            out.println(settle_ms);
+            out.print(F("commands: "));
+            out.print(commands);
+            out.print(F(" errors: "));
+            out.print(command_errors);
+            out.print(F(" timeouts: "));
+            out.println(timeouts);
+
+            out.print(F("urcs:"));
+            for (uint8_t urc = 0; urc < URC_COUNT; urc++) {
+                out.print(' ');
+                out.print(urc_names[urc]);
+                out.print('=');
+                out.print(urcs[urc]);
+            }
+            out.println();
+
+            out.print(F("connects: "));
+            out.print(connects);
+            out.print(F(" disconnects: "));
+            out.println(disconnects);
+            connect_latency.dump(out, "connect");
+            wake_latency.dump(out, "wake");
+
+            for (uint8_t command = 0; command < STATS_CMD_COUNT; command++) {
+                if (command_latency[command].samples == 0)
+                    continue;
+
+                out.print(F("AT+"));
+                command_latency[command].dump(out, commandName(command));
+            }
+        }
+};
+
+#endif
+
+#endif
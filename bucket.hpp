@@ -1,29 +1,54 @@
+#ifndef BT_BUCKET_HPP
+#define BT_BUCKET_HPP
+
 #include <Arduino.h>
 
+/**
+ * Token bucket: holds up to `bucket_size` tokens and gains `period_tokens`
+ * every `period_ms`, credited as time passes without losing fractions.
+ */
 class Bucket
 {
     private:
         uint32_t _bucket_size;
         uint32_t _available_tokens = 0;
-        uint32_t _token_refill_ms;
+        uint32_t _period_tokens;
+        uint32_t _period_ms;
+        uint32_t _credit = 0; // token fractions, in 1/_period_ms
 
-        uint32_t _last_request_time;
+        uint32_t _last_refill_time;
 
         void _refill_tokens()
         {
             uint32_t current_time = millis();
-            uint32_t elapsed_time = current_time - _last_request_time;
+            uint32_t elapsed_time = current_time - _last_refill_time;
+            _last_refill_time     = current_time;
+
+            // Long enough to fill any bucket, and keeps the product below from overflowing
+            if (elapsed_time >= _period_ms * (_bucket_size / _period_tokens + 1)) {
+                _available_tokens = _bucket_size;
+                _credit           = 0;
+                return;
+            }
 
-            uint32_t tokens_to_add = elapsed_time / _token_refill_ms;
+            _credit += elapsed_time * _period_tokens;
+            uint32_t tokens_to_add = _credit / _period_ms;
+            _credit %= _period_ms;
 
             _available_tokens = min(_available_tokens + tokens_to_add, _bucket_size);
+            if (_available_tokens == _bucket_size)
+                _credit = 0;
         }
 
     public:
         Bucket(uint32_t bucket_size) : Bucket(bucket_size, 20){};
 
+        /**
+         * One token every `token_refill_ms`.
+         */
         Bucket(uint32_t bucket_size, uint32_t token_refill_ms)
-            : _bucket_size(bucket_size), _token_refill_ms(token_refill_ms), _last_request_time(millis()){};
+            : _bucket_size(bucket_size), _period_tokens(1), _period_ms(token_refill_ms),
+              _last_refill_time(millis()){};
 
         ~Bucket(){};
 
@@ -33,7 +58,44 @@ class Bucket
             while (_available_tokens <= 0) {
                 _refill_tokens();
             }
-            _last_request_time = millis();
             _available_tokens -= 1;
         }
+
+        /**
+         * Tokens that could be taken right now without waiting.
+         */
+        uint32_t available_tokens()
+        {
+            _refill_tokens();
+            return _available_tokens;
+        }
+
+        /**
+         * Change the refill to `tokens_per_s` (at least 1), keeping the tokens held.
+         */
+        void set_rate(uint32_t tokens_per_s)
+        {
+            _refill_tokens();
+            _period_tokens = max(tokens_per_s, (uint32_t)1);
+            _period_ms     = 1000;
+            _credit        = 0;
+        }
+
+        uint32_t rate() const
+        {
+            return (uint32_t)((uint64_t)_period_tokens * 1000 / _period_ms);
+        }
+
+        /**
+         * Take up to `count` tokens without waiting. Returns how many were taken.
+         */
+        uint32_t take_tokens(uint32_t count)
+        {
+            _refill_tokens();
+            count = min(count, _available_tokens);
+            _available_tokens -= count;
+            return count;
+        }
 };
+
+#endif
@@ -0,0 +1,108 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+namespace bench
+{
+    const uint8_t PEER_MAC[6] = { 0x98, 0xD3, 0x31, 0xFB, 0x12, 0x34 };
+
+    namespace
+    {
+        struct Entry {
+                const char* name;
+                BenchFn fn;
+        };
+
+        std::vector<Entry>& registry()
+        {
+            static std::vector<Entry> entries;
+            return entries;
+        }
+
+        host::Stats start_stats;
+        uint64_t start_sim;
+        std::chrono::steady_clock::time_point start_wall;
+    }
+
+    Registrar::Registrar(const char* name, BenchFn fn)
+    {
+        registry().push_back(Entry{ name, fn });
+    }
+
+    Rig::Rig(unsigned long baud, const JDY31Sim::Config& config)
+        : uart(), module(uart, CMD_PIN, STATE_PIN, -1, withBaud(config, baud)), bt(&uart, CMD_PIN, STATE_PIN)
+    {
+        bt.begin(baud);
+        attachIsr(uart, bt);
+    }
+
+    void attachIsr(Uart& uart, Bluetooth& bt)
+    {
+#if BT_ISR_RX
+        uart.onReceive([](void* ctx) { ((Bluetooth*)ctx)->isrDrain(); }, &bt);
+#else
+        (void)uart;
+        (void)bt;
+#endif
+    }
+
+    void begin()
+    {
+        start_stats = host::stats;
+        start_sim   = host::now();
+        start_wall  = std::chrono::steady_clock::now();
+    }
+
+    Result end()
+    {
+        std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+
+        Result result;
+        result.sim_us   = host::now() - start_sim;
+        result.delay_us = host::stats.delay_us - start_stats.delay_us;
+        result.spin_us  = host::stats.spin_us - start_stats.spin_us;
+        result.block_us = host::stats.block_us - start_stats.block_us;
+        result.wall_ns  = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start_wall).count();
+        return result;
+    }
+
+    void report(const char* name, const Result& r, const char* note)
+    {
+        printf("%-40s %10.3f %10.3f %10.3f %10.3f %12.3f  %s\n",
+               name,
+               r.sim_us / 1000.0,
+               r.delay_us / 1000.0,
+               r.spin_us / 1000.0,
+               r.block_us / 1000.0,
+               r.wall_ns / 1000.0,
+               note);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    printf("%-40s %10s %10s %10s %10s %12s  %s\n",
+           "benchmark",
+           "sim ms",
+           "delay ms",
+           "spin ms",
+           "block ms",
+           "wall us",
+           "note");
+
+    std::vector<bench::Entry>& entries = bench::registry();
+    for (size_t i = 0; i < entries.size(); i++) {
+        bool selected = argc < 2;
+        for (int a = 1; a < argc; a++)
+            if (strstr(entries[i].name, argv[a]) != NULL)
+                selected = true;
+
+        if (selected)
+            entries[i].fn();
+    }
+
+    return 0;
+}
@@ -0,0 +1,97 @@
+#ifndef BT_BENCH_HPP
+#define BT_BENCH_HPP
+
+#include "bluetooth.hpp"
+#include "host.hpp"
+#include "jdy31_sim.hpp"
+
+#include <stdint.h>
+
+/**
+ * Tiny benchmark harness for the host build.
+ *
+ * Every benchmark reports the simulated time the firmware would have spent
+ * (and how much of it was delay()/busy-wait/UART blocking) next to the
+ * wall-clock cost of running the library code on the host.
+ */
+namespace bench
+{
+    const int CMD_PIN   = 2;
+    const int STATE_PIN = 3;
+    const int POWER_PIN = 4;
+
+    typedef void (*BenchFn)();
+
+    struct Registrar {
+            Registrar(const char* name, BenchFn fn);
+    };
+
+    struct Result {
+            uint64_t sim_us;
+            uint64_t delay_us;
+            uint64_t spin_us;
+            uint64_t block_us;
+            uint64_t wall_ns;
+    };
+
+    /**
+     * Resets the simulation when constructed, so it must be the first member
+     * of anything owning simulated hardware.
+     */
+    struct HostReset {
+            HostReset()
+            {
+                host::reset();
+            }
+    };
+
+    /**
+     * One module on one UART with the library on top.
+     */
+    struct Rig {
+            HostReset host_reset;
+            Uart uart;
+            JDY31Sim module;
+            Bluetooth bt;
+
+            Rig(unsigned long baud, const JDY31Sim::Config& config = JDY31Sim::Config());
+
+            static JDY31Sim::Config withBaud(JDY31Sim::Config config, unsigned long baud)
+            {
+                config.baud = baud;
+                return config;
+            }
+    };
+
+    extern const uint8_t PEER_MAC[6];
+
+    /**
+     * With BT_ISR_RX, runs `bt.isrDrain()` from the receive interrupt of
+     * `uart`, as a board's SERCOM handler would. Does nothing otherwise.
+     */
+    void attachIsr(Uart& uart, Bluetooth& bt);
+
+    void begin();
+
+    Result end();
+
+    /**
+     * Print a result row. `note` is free-form (e.g. a returned value).
+     */
+    void report(const char* name, const Result& result, const char* note = "");
+
+    template <class Fn>
+    Result measure(Fn fn)
+    {
+        begin();
+        fn();
+        return end();
+    }
+}
+
+#define BENCH(fn)                                                                                                      \
+    static void fn();                                                                                                  \
+    static bench::Registrar fn##_registrar(#fn, fn);                                                                   \
+    static void fn()
+
+#endif
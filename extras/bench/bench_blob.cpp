@@ -0,0 +1,208 @@
+#include "bench.hpp"
+#include "blob_transfer.hpp"
+
+#include <stdio.h>
+
+namespace
+{
+    const uint32_t BLOB_SIZE   = 64 * 1024;
+    const size_t CHUNK_SIZE    = 128;
+    const uint8_t WINDOWS[]    = { 1, 4, 16 };
+    const unsigned long LIMIT  = 600000; // ms of simulated time per transfer
+
+    // Faster than any UART baud, so only the latency shows
+    const uint32_t LINK_RATE       = 20000;
+    const uint32_t LINK_LATENCY_US = 30000;
+
+    uint8_t blobByte(uint32_t offset)
+    {
+        return (uint8_t)(offset * 31 + (offset >> 9));
+    }
+
+    size_t readBlob(uint32_t offset, uint8_t* buffer, size_t length, void* ctx)
+    {
+        (void)ctx;
+        for (size_t i = 0; i < length; i++)
+            buffer[i] = blobByte(offset + i);
+        return length;
+    }
+
+    struct Check {
+            uint32_t bytes;
+            uint32_t errors;
+    };
+
+    void writeBlob(uint32_t offset, const uint8_t* data, size_t length, void* ctx)
+    {
+        Check* check = (Check*)ctx;
+
+        for (size_t i = 0; i < length; i++)
+            check->errors += data[i] != blobByte(offset + i);
+        check->bytes += length;
+    }
+
+    /**
+     * The peer's answers, sent back over the link.
+     */
+    struct PeerPrint : public Print {
+            JDY31Sim& module;
+
+            PeerPrint(JDY31Sim& module) : module(module)
+            {
+            }
+
+            size_t write(uint8_t value) override
+            {
+                module.peerSend(&value, 1);
+                return 1;
+            }
+
+            size_t write(const uint8_t* buffer, size_t size) override
+            {
+                module.peerSend(buffer, size);
+                return size;
+            }
+    };
+
+    struct Outcome {
+            bench::Result result;
+            Check check;
+            TransferStatus status;
+            uint32_t retransmits;
+            uint32_t resumes;
+    };
+
+    /**
+     * Sends the blob to a BlobReceiver on the peer, polling until done.
+     * `disconnect_at`: the peer drops the link once that many bytes have
+     * been acknowledged, and connects again 2 s later (0: never).
+     */
+    Outcome transfer(unsigned long baud, uint8_t window, uint32_t loss_ppm, uint32_t disconnect_at)
+    {
+        JDY31Sim::Config config = bench::Rig::withBaud(JDY31Sim::Config(), baud);
+        config.link_rate        = LINK_RATE;
+        config.link_buffer      = 4096;
+        config.link_latency_us  = LINK_LATENCY_US;
+        config.link_loss_ppm    = loss_ppm;
+
+        bench::Rig rig(baud, config);
+        rig.module.connectPeer(bench::PEER_MAC);
+        rig.bt.waitForConnection(2000);
+
+        static uint8_t send_buffer[CHUNK_SIZE + BLOB_HEADER_SIZE];
+        static uint8_t receive_buffer[CHUNK_SIZE + BLOB_HEADER_SIZE + FRAME_CRC_SIZE];
+
+        Outcome outcome = {};
+        PeerPrint peer(rig.module);
+        BlobSender sender(send_buffer, sizeof(send_buffer), window);
+        BlobReceiver receiver(receive_buffer, sizeof(receive_buffer), writeBlob, &outcome.check);
+        size_t seen = 0;
+
+        outcome.result = bench::measure([&]() {
+            unsigned long start = millis();
+            rig.bt.beginTransfer(&sender, readBlob, BLOB_SIZE);
+
+            while (sender.active() && millis() - start < LIMIT) {
+                rig.bt.poll();
+
+                const std::vector<uint8_t>& received = rig.module.peerReceived();
+                while (seen < received.size())
+                    receiver.feed(received[seen++], peer);
+
+                if (disconnect_at > 0 && rig.bt.transferOffset() >= disconnect_at) {
+                    disconnect_at = 0;
+                    rig.module.disconnectPeer();
+                    rig.module.connectPeer(bench::PEER_MAC, 2000000);
+                }
+            }
+        });
+
+        outcome.status      = rig.bt.transferStatus();
+        outcome.retransmits = sender.retransmits();
+        outcome.resumes     = sender.resumes();
+        return outcome;
+    }
+
+    void report(const char* name, unsigned long baud, const Outcome& outcome)
+    {
+        char note[128];
+        snprintf(note,
+                 sizeof(note),
+                 "%s, %lu/%lu B, %lu bad, %.0f B/s (%.0f%% of the line), %lu resent, %lu resumes",
+                 outcome.status == TRANSFER_DONE ? "done" : "not done",
+                 (unsigned long)outcome.check.bytes,
+                 (unsigned long)BLOB_SIZE,
+                 (unsigned long)outcome.check.errors,
+                 outcome.check.bytes / (outcome.result.sim_us / 1000000.0),
+                 100.0 * outcome.check.bytes / (outcome.result.sim_us / 1000000.0) / (baud / 10),
+                 (unsigned long)outcome.retransmits,
+                 (unsigned long)outcome.resumes);
+        bench::report(name, outcome.result, note);
+    }
+}
+
+/**
+ * A 64 KB blob in 128 byte chunks at every baud the module supports, with
+ * a window of 1 (stop-and-wait), 4 and 16 chunks, over a link with 30 ms
+ * of latency each way.
+ */
+BENCH(blobTransfer)
+{
+    for (int b = 0; b < 6; b++) {
+        for (uint8_t window : WINDOWS) {
+            unsigned long baud = JDY31Sim::RATES[b];
+            char name[48];
+
+            snprintf(name, sizeof(name), "blob @%lu, window %u", baud, window);
+            report(name, baud, transfer(baud, window, 0, 0));
+        }
+    }
+}
+
+/**
+ * Same blob at 115200 with a window of 16 over a lossy link (bytes lost on
+ * air corrupt their chunk), and cut once half of it is acknowledged: the
+ * transfer resumes on the next connection.
+ */
+BENCH(blobResume)
+{
+    report("blob @115200, 200 ppm loss", 115200, transfer(115200, 16, 200, 0));
+    report("blob @115200, cut at 32 KB", 115200, transfer(115200, 16, 0, BLOB_SIZE / 2));
+    report("blob @115200, both", 115200, transfer(115200, 16, 200, BLOB_SIZE / 2));
+}
+
+/**
+ * Sender buffers at the edges: none or a bare header hold no chunk, so
+ * `begin()` fails; a chunk too large for the START frame is cut to
+ * UINT16_MAX bytes, which shows in where a transfer resumes.
+ */
+BENCH(blobBuffer)
+{
+    static const size_t SIZES[] = { 0, BLOB_HEADER_SIZE, BLOB_HEADER_SIZE + 1, 70000 };
+    static uint8_t buffer[70000];
+    const uint32_t resume_at = 2 * (uint32_t)UINT16_MAX;
+    TransferStatus status[4];
+    uint32_t offset = 0;
+
+    bench::Result r = bench::measure([&]() {
+        for (int i = 0; i < 4; i++) {
+            BlobSender sender(buffer, SIZES[i]);
+            sender.begin(readBlob, NULL, 200000, resume_at);
+            status[i] = sender.status();
+            offset    = sender.offset();
+        }
+    });
+
+    char note[128];
+    snprintf(note,
+             sizeof(note),
+             "%s/%s/%s for 0/%u/%u B, 70000 B resumes at %lu of %lu",
+             status[0] == TRANSFER_FAILED ? "failed" : "started",
+             status[1] == TRANSFER_FAILED ? "failed" : "started",
+             status[2] == TRANSFER_FAILED ? "failed" : "started",
+             (unsigned)BLOB_HEADER_SIZE,
+             (unsigned)BLOB_HEADER_SIZE + 1,
+             (unsigned long)offset,
+             (unsigned long)resume_at);
+    bench::report("blob sender buffer sizes", r, note);
+}
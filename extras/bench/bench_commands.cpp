@@ -0,0 +1,215 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <stdio.h>
+
+BENCH(findBaud)
+{
+    static const unsigned long bauds[] = { 9600, 115200 };
+
+    for (size_t i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++) {
+        bench::Rig rig(bauds[i]);
+        unsigned long found = 0;
+        char name[48], note[32];
+
+        bench::Result r = bench::measure([&]() { found = rig.bt.findBaud(); });
+
+        snprintf(name, sizeof(name), "findBaud (module @%lu)", bauds[i]);
+        snprintf(note, sizeof(note), "found %lu", found);
+        bench::report(name, r, note);
+    }
+}
+
+/**
+ * Boot-time discovery: the port starts at 9600 whatever the module runs at.
+ * "typical" has the last working rate as hint, "no hint" searches blind.
+ */
+BENCH(discoverBaud)
+{
+    static const unsigned long bauds[] = { 9600, 115200 };
+
+    for (size_t i = 0; i < sizeof(bauds) / sizeof(bauds[0]); i++) {
+        for (int hinted = 1; hinted >= 0; hinted--) {
+            bench::Rig rig(bauds[i]);
+            unsigned long found = 0;
+            char name[48], note[32];
+
+            rig.bt.begin(9600);
+            bench::Result r = bench::measure([&]() { found = rig.bt.discoverBaud(hinted ? bauds[i] : 0); });
+
+            snprintf(name, sizeof(name), "discoverBaud (module @%lu, %s)", bauds[i], hinted ? "hint" : "no hint");
+            snprintf(note, sizeof(note), "found %lu", found);
+            bench::report(name, r, note);
+        }
+    }
+
+    // Worst case: nothing answers at any rate
+    bench::Rig rig(9600);
+    unsigned long found = 1;
+
+    rig.uart.attach(NULL);
+    bench::Result r = bench::measure([&]() { found = rig.bt.discoverBaud(9600); });
+    bench::report("discoverBaud (no module)", r, found == 0 ? "none" : "unexpected");
+
+    bench::Rig legacy(9600);
+    legacy.uart.attach(NULL);
+    bench::report("  findBaud (no module)", bench::measure([&]() { legacy.bt.findBaud(); }));
+}
+
+BENCH(setName)
+{
+    bench::Rig rig(9600);
+    bool ok = false;
+
+    bench::Result r = bench::measure([&]() { ok = rig.bt.setName((char*)"SENSOR-01"); });
+    bench::report("setName", r, ok ? "ok" : "failed");
+}
+
+BENCH(setPin)
+{
+    bench::Rig rig(9600);
+    bool ok = false;
+
+    bench::Result r = bench::measure([&]() { ok = rig.bt.setPin((char*)"4321"); });
+    bench::report("setPin", r, ok ? "ok" : "failed");
+}
+
+BENCH(reset)
+{
+    bench::Rig rig(9600);
+
+    bench::report("reset", bench::measure([&]() { rig.bt.reset(); }));
+}
+
+BENCH(waitForConnection)
+{
+    bench::Rig rig(9600);
+    bool connected = false;
+
+    rig.module.connectPeer(bench::PEER_MAC, 1000000);
+    bench::Result r = bench::measure([&]() { connected = rig.bt.waitForConnection(10000); });
+    bench::report("waitForConnection (peer @1s)", r, connected ? "connected" : "timed out");
+}
+
+BENCH(getVersion)
+{
+    bench::Rig rig(9600);
+    char version[32];
+
+    bench::Result r = bench::measure([&]() { rig.bt.getVersion(version, sizeof(version)); });
+    bench::report("getVersion", r, version);
+}
+
+/**
+ * Same query through the asynchronous engine: the figure that matters is the
+ * longest single poll(), i.e. how long the main loop is held up.
+ */
+BENCH(submitCommand)
+{
+    bench::Rig rig(9600);
+    uint64_t longest_poll = 0;
+    int polls             = 0;
+    char note[64];
+
+    bench::Result r = bench::measure([&]() {
+        int handle = rig.bt.submitCommand("AT+VERSION", NULL, 5000);
+        while (rig.bt.commandPending()) {
+            uint64_t start = host::now();
+            rig.bt.poll();
+            polls++;
+            if (host::now() - start > longest_poll)
+                longest_poll = host::now() - start;
+        }
+        (void)handle;
+    });
+
+    snprintf(note, sizeof(note), "%d polls, longest %llu us", polls, (unsigned long long)longest_poll);
+    bench::report("submitCommand (AT+VERSION)", r, note);
+}
+
+/**
+ * The same AT+NAME command, free-form (name and argument copied into the
+ * slot) and from the command table (argument only, name streamed from
+ * flash), 100 times at 115200. Reports the sim time per command and the
+ * host time spent in `submitCommand()`.
+ *
+ * On AVR the table moves the command literals out of RAM: the 7 names
+ * (62 bytes) plus the probe line (13 bytes) the library used to hold.
+ */
+BENCH(commandTable)
+{
+    typedef std::chrono::steady_clock Clock;
+    static const int COMMANDS = 100;
+
+    for (int table = 0; table < 2; table++) {
+        bench::Rig rig(115200);
+        int done           = 0;
+        uint64_t submit_ns = 0;
+
+        bench::Result r = bench::measure([&]() {
+            rig.bt.beginCommandSession();
+            for (int i = 0; i < COMMANDS; i++) {
+                Clock::time_point start = Clock::now();
+                int handle              = table ? rig.bt.submitCommand(AT_NAME, "SENSOR-01", 1000)
+                                                : rig.bt.submitCommand("AT+NAME", "SENSOR-01", 1000);
+                submit_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+
+                CommandStatus status;
+                while ((status = rig.bt.commandStatus(handle)) == COMMAND_QUEUED || status == COMMAND_RUNNING)
+                    rig.bt.poll();
+                done += status == COMMAND_DONE;
+            }
+            rig.bt.endCommandSession();
+            while (rig.bt.inCommandSession() || rig.bt.commandPending())
+                rig.bt.poll();
+        });
+
+        char note[80];
+        snprintf(note,
+                 sizeof(note),
+                 "%d/%d done, %.2f sim ms/command, submit %.0f host ns",
+                 done,
+                 COMMANDS,
+                 r.sim_us / 1000.0 / COMMANDS,
+                 (double)submit_ns / COMMANDS);
+        bench::report(table ? "  AT_NAME from the table" : "\"AT+NAME\" free-form", r, note);
+    }
+}
+
+/**
+ * A status endpoint asking for the module identity over and over.
+ */
+BENCH(configCache)
+{
+    bench::Rig rig(9600);
+    char name[32], pin[16], version[32], bauds[16];
+
+    bench::Result first = bench::measure([&]() {
+        rig.bt.getVersion(version, sizeof(version));
+        rig.bt.getName(name, sizeof(name));
+        rig.bt.getPin(pin, sizeof(pin));
+        rig.bt.getBauds(bauds, sizeof(bauds));
+    });
+    bench::report("config queries, cold", first, name);
+
+    bench::Result repeat = bench::measure([&]() {
+        for (int i = 0; i < 100; i++) {
+            rig.bt.getVersion(version, sizeof(version));
+            rig.bt.getName(name, sizeof(name));
+            rig.bt.getPin(pin, sizeof(pin));
+            rig.bt.getBauds(bauds, sizeof(bauds));
+        }
+    });
+
+    char note[64];
+    snprintf(note,
+             sizeof(note),
+             "x100, hits %lu misses %lu",
+             (unsigned long)rig.bt.configCacheHits(),
+             (unsigned long)rig.bt.configCacheMisses());
+    bench::report("config queries, cached", repeat, note);
+
+    rig.bt.setName((char*)"SENSOR-02");
+    rig.bt.getName(name, sizeof(name));
+    bench::report("  after setName", bench::Result(), name);
+}
@@ -0,0 +1,194 @@
+#include "bench.hpp"
+
+#include <memory>
+#include <stdio.h>
+#include <vector>
+
+namespace
+{
+    const int LINKS              = 3;
+    const uint32_t RECONNECT_US  = 1000000; // the peer comes back 1 s after the reset
+    const unsigned long LIMIT_MS = 30000;
+
+    const char* const NAMES[] = { "SENSOR-01", "SENSOR-02", "SENSOR-03" };
+
+    struct Link {
+            Uart uart;
+            JDY31Sim module;
+            Bluetooth bt;
+            bool done = false;
+            bool ok   = false;
+
+            Link(int index)
+                : uart(), module(uart, 10 + index, 20 + index, -1, bench::Rig::withBaud(JDY31Sim::Config(), 115200)),
+                  bt(&uart, 10 + index, 20 + index)
+            {
+                bt.begin(115200);
+                bench::attachIsr(uart, bt);
+                module.connectPeer(bench::PEER_MAC);
+            }
+    };
+
+    enum FlowStyle {
+        FLOW_BLOCKING,
+        FLOW_COROUTINE,
+        FLOW_PROTOTHREAD,
+    };
+
+    /**
+     * Blocking calls, one link after the other: the loop stalls for the
+     * whole of each provisioning.
+     */
+    void provisionBlocking(Link& link, int index)
+    {
+        char version[32];
+
+        link.ok = link.bt.runCommand(AT_VERSION, NULL, 1000, version, sizeof(version)) == COMMAND_DONE
+                  && link.bt.runCommand(AT_NAME, NAMES[index], 1000) == COMMAND_DONE
+                  && link.bt.runCommand(AT_PIN, "1234", 1000) == COMMAND_DONE
+                  && link.bt.runCommand(AT_RESET, NULL, 1000) == COMMAND_DONE;
+
+        if (link.ok) {
+            link.module.connectPeer(bench::PEER_MAC, RECONNECT_US);
+            link.ok = link.bt.waitForConnection(5000);
+        }
+        link.done = true;
+    }
+
+#if BT_COROUTINES
+    BtTask provisionCoroutine(Link& link, int index)
+    {
+        BtReply reply = co_await link.bt.command(AT_VERSION);
+
+        if (reply.status == COMMAND_DONE)
+            reply = co_await link.bt.command(AT_NAME, NAMES[index]);
+        if (reply.status == COMMAND_DONE)
+            reply = co_await link.bt.command(AT_PIN, "1234");
+        if (reply.status == COMMAND_DONE)
+            reply = co_await link.bt.command(AT_RESET);
+
+        if (reply.status == COMMAND_DONE) {
+            link.module.connectPeer(bench::PEER_MAC, RECONNECT_US);
+            link.ok = co_await link.bt.connected(5000);
+        }
+        link.done = true;
+    }
+#endif
+
+    class Provision : public BtFlow
+    {
+        private:
+            Link& link;
+            int index;
+
+        public:
+            Provision(Link& link, int index) : link(link), index(index) {}
+
+            void run() override
+            {
+                BT_FLOW_BEGIN();
+
+                BT_AWAIT(link.bt.command(AT_VERSION));
+                if (reply().status != COMMAND_DONE)
+                    BT_FLOW_EXIT();
+                BT_AWAIT(link.bt.command(AT_NAME, NAMES[index]));
+                if (reply().status != COMMAND_DONE)
+                    BT_FLOW_EXIT();
+                BT_AWAIT(link.bt.command(AT_PIN, "1234"));
+                if (reply().status != COMMAND_DONE)
+                    BT_FLOW_EXIT();
+                BT_AWAIT(link.bt.command(AT_RESET));
+                if (reply().status != COMMAND_DONE)
+                    BT_FLOW_EXIT();
+
+                link.module.connectPeer(bench::PEER_MAC, RECONNECT_US);
+                BT_AWAIT(link.bt.connected(5000));
+                link.ok = connected();
+
+                BT_FLOW_END();
+            }
+    };
+
+    /**
+     * Provisions every link from one loop that also polls them all, and
+     * reports how long the loop was held at worst.
+     */
+    void run(FlowStyle style, const char* name)
+    {
+        bench::HostReset reset;
+        std::vector<std::unique_ptr<Link>> links;
+        std::vector<std::unique_ptr<Provision>> flows;
+
+        for (int i = 0; i < LINKS; i++)
+            links.emplace_back(new Link(i));
+        for (int i = 0; i < LINKS; i++)
+            links[i]->bt.waitForConnection(2000);
+
+        uint64_t worst_stall = 0;
+        int provisioned      = 0;
+
+        bench::Result r = bench::measure([&]() {
+            for (int i = 0; i < LINKS; i++) {
+                if (style == FLOW_PROTOTHREAD) {
+                    flows.emplace_back(new Provision(*links[i], i));
+                    flows[i]->start();
+                }
+#if BT_COROUTINES
+                if (style == FLOW_COROUTINE)
+                    provisionCoroutine(*links[i], i);
+#endif
+            }
+
+            unsigned long start = millis();
+            int next            = 0;
+
+            for (;;) {
+                uint64_t loop_start = host::now();
+                int done            = 0;
+
+                for (int i = 0; i < LINKS; i++)
+                    links[i]->bt.poll();
+
+                if (style == FLOW_BLOCKING && next < LINKS) {
+                    provisionBlocking(*links[next], next);
+                    next++;
+                }
+
+                for (int i = 0; i < LINKS; i++)
+                    done += links[i]->done || (style == FLOW_PROTOTHREAD && !flows[i]->running());
+
+                if (host::now() - loop_start > worst_stall)
+                    worst_stall = host::now() - loop_start;
+
+                if (done == LINKS || millis() - start > LIMIT_MS)
+                    break;
+            }
+        });
+
+        for (int i = 0; i < LINKS; i++)
+            provisioned += links[i]->ok;
+
+        char note[96];
+        snprintf(note,
+                 sizeof(note),
+                 "%d/%d provisioned, loop held %llu us at worst",
+                 provisioned,
+                 LINKS,
+                 (unsigned long long)worst_stall);
+        bench::report(name, r, note);
+    }
+}
+
+/**
+ * Three modules each queried, renamed, given a PIN and reset, then waiting
+ * for their peer to reconnect: with blocking calls one after the other,
+ * and as flows running side by side (coroutines only in a C++20 build).
+ */
+BENCH(provisionFlows)
+{
+    run(FLOW_BLOCKING, "provision x3, blocking");
+#if BT_COROUTINES
+    run(FLOW_COROUTINE, "provision x3, coroutines");
+#endif
+    run(FLOW_PROTOTHREAD, "provision x3, protothreads");
+}
@@ -0,0 +1,190 @@
+#include "bench.hpp"
+#include "frame_codec.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+namespace
+{
+    const int RECORDS = 100;
+
+    struct Record {
+            uint32_t timestamp;
+            int16_t temperature;
+            uint16_t humidity;
+            uint32_t pressure;
+            uint8_t status[12];
+    };
+
+    Record record(int i)
+    {
+        Record r = { (uint32_t)i * 1000, (int16_t)(2351 + i), 4120, 101320, { 0 } };
+        r.status[0] = (uint8_t)i;
+        return r;
+    }
+
+    void connect(bench::Rig& rig)
+    {
+        rig.module.connectPeer(bench::PEER_MAC);
+        rig.bt.waitForConnection(2000);
+
+        // Drop the connection URCs (and the rest of their line) so both
+        // paths start on a clean stream
+        delay(50);
+        const uint8_t* data;
+        while (size_t length = rig.bt.peekBuffer(&data))
+            rig.bt.consume(length);
+    }
+
+    uint8_t hexValue(char c)
+    {
+        return c <= '9' ? c - '0' : c - 'A' + 10;
+    }
+
+    /**
+     * Counts the records that arrive whole and in order.
+     */
+    void countFrame(Bluetooth* bt, const uint8_t* data, size_t length, void* ctx)
+    {
+        (void)bt;
+        int* received = (int*)ctx;
+        Record r;
+
+        if (length != sizeof(Record))
+            return;
+
+        memcpy(&r, data, sizeof(r));
+        if (r.timestamp == record(*received).timestamp)
+            (*received)++;
+    }
+}
+
+/**
+ * Binary sensor records from the peer: hex lines read with readBytesUntil()
+ * against COBS frames decoded by poll().
+ */
+BENCH(rxFrames)
+{
+    static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+    std::string lines, frames;
+    for (int i = 0; i < RECORDS; i++) {
+        Record r = record(i);
+        const uint8_t* bytes = (const uint8_t*)&r;
+        uint8_t encoded[64];
+
+        for (size_t b = 0; b < sizeof(r); b++) {
+            lines += HEX_DIGITS[bytes[b] >> 4];
+            lines += HEX_DIGITS[bytes[b] & 0x0F];
+        }
+        lines += "\r\n";
+
+        frames.append((const char*)encoded, FrameEncoder::encode(bytes, sizeof(r), encoded, sizeof(encoded)));
+    }
+
+    {
+        bench::Rig rig(9600);
+        connect(rig);
+
+        int received = 0;
+        char line[64];
+        Record r;
+
+        rig.module.peerSend(lines.c_str());
+        rig.bt.setTimeout(100);
+
+        bench::Result result = bench::measure([&]() {
+            while (received < RECORDS) {
+                size_t n = rig.bt.readBytesUntil('\n', line, sizeof(line));
+                if (n == 0)
+                    break;
+
+                uint8_t* bytes = (uint8_t*)&r;
+                for (size_t b = 0; b < sizeof(r) && 2 * b + 1 < n; b++)
+                    bytes[b] = hexValue(line[2 * b]) << 4 | hexValue(line[2 * b + 1]);
+                received++;
+            }
+        });
+
+        char note[64];
+        snprintf(note, sizeof(note), "%d records, %zu bytes on air", received, lines.size());
+        bench::report("rx hex lines (9600)", result, note);
+    }
+
+    {
+        bench::Rig rig(9600);
+        connect(rig);
+
+        int received = 0;
+        uint8_t buffer[sizeof(Record) + FRAME_CRC_SIZE];
+        FrameDecoder decoder(buffer, sizeof(buffer));
+
+        rig.bt.setFrameHandler(&decoder, countFrame, &received);
+        rig.module.peerSend((const uint8_t*)frames.data(), frames.size());
+
+        bench::Result result = bench::measure([&]() {
+            unsigned long start = millis();
+            while (received < RECORDS && millis() - start < 10000)
+                rig.bt.poll();
+        });
+
+        char note[64];
+        snprintf(note,
+                 sizeof(note),
+                 "%d records, %zu bytes on air, %lu errors",
+                 received,
+                 frames.size(),
+                 (unsigned long)decoder.errors());
+        bench::report("rx frames (9600)", result, note);
+    }
+}
+
+/**
+ * The same records sent to the peer.
+ */
+BENCH(txFrames)
+{
+    {
+        bench::Rig rig(9600);
+        connect(rig);
+
+        bench::Result result = bench::measure([&]() {
+            for (int i = 0; i < RECORDS; i++) {
+                Record r             = record(i);
+                const uint8_t* bytes = (const uint8_t*)&r;
+
+                for (size_t b = 0; b < sizeof(r); b++) {
+                    if (bytes[b] < 0x10)
+                        rig.bt.print('0');
+                    rig.bt.print(bytes[b], HEX);
+                }
+                rig.bt.println();
+            }
+            rig.uart.flush();
+        });
+
+        char note[64];
+        snprintf(note, sizeof(note), "peer got %zu bytes", rig.module.peerReceived().size());
+        bench::report("tx hex lines (9600)", result, note);
+    }
+
+    {
+        bench::Rig rig(9600);
+        connect(rig);
+
+        int sent = 0;
+
+        bench::Result result = bench::measure([&]() {
+            for (int i = 0; i < RECORDS; i++) {
+                Record r = record(i);
+                sent += rig.bt.sendFrame((const uint8_t*)&r, sizeof(r));
+            }
+            rig.uart.flush();
+        });
+
+        char note[64];
+        snprintf(note, sizeof(note), "%d frames, peer got %zu bytes", sent, rig.module.peerReceived().size());
+        bench::report("tx frames (9600)", result, note);
+    }
+}
@@ -0,0 +1,136 @@
+#include "bench.hpp"
+#include "spsc_queue.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    /**
+     * Stands in for the RX interrupt: `count` bytes of a counting sequence,
+     * one every `byte_ns` of real time (0: as fast as possible). Paced
+     * bytes are pushed in bursts of whatever is due, waking every 100 us,
+     * so the run also works on a single core.
+     */
+    template <class Push>
+    std::thread producer(size_t count, uint64_t byte_ns, Push push)
+    {
+        return std::thread([count, byte_ns, push]() {
+            Clock::time_point start = Clock::now();
+            size_t sent             = 0;
+
+            while (sent < count) {
+                size_t due = count;
+                if (byte_ns > 0) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(100));
+                    due = min((size_t)(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count() / byte_ns), count);
+                }
+
+                for (; sent < due; sent++)
+                    push((uint8_t)sent);
+            }
+        });
+    }
+}
+
+/**
+ * The queue alone, producer thread against consumer thread, both flat out.
+ * The producer retries when the queue is full, so every byte has to come
+ * out once and in order.
+ */
+BENCH(spscQueue)
+{
+    static const size_t COUNT = 1 << 22;
+    static SpscQueue<512> queue;
+
+    size_t received = 0, errors = 0;
+    uint8_t expected = 0;
+    Clock::time_point start = Clock::now();
+
+    std::thread thread = producer(COUNT, 0, [](uint8_t value) {
+        while (!queue.push(value))
+            std::this_thread::yield();
+    });
+
+    while (received < COUNT) {
+        uint8_t chunk[64];
+        size_t length = queue.pop(chunk, sizeof(chunk));
+        if (length == 0)
+            std::this_thread::yield();
+
+        for (size_t i = 0; i < length; i++)
+            errors += chunk[i] != expected++;
+        received += length;
+    }
+    thread.join();
+
+    double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    char note[96];
+    snprintf(note, sizeof(note), "%zu bytes, %zu out of order, %.1f ns/byte", received, errors, ns / received);
+    bench::report("SpscQueue<512> threads, flat out", bench::Result(), note);
+}
+
+/**
+ * ISR RX path at 115200 line rate for two seconds of real time. The main
+ * loop reads with `read()` but stalls every 200 ms, the way it does in a
+ * blocking call, for 10 to 80 ms. Stalls are absorbed up to what the ISR
+ * queue and the RX buffer hold together (768 bytes by default, 67 ms at
+ * 115200; the Uart's own 64 bytes last 5.6 ms), beyond that they have to
+ * show as ISR overflows.
+ */
+BENCH(isrRx)
+{
+#if BT_ISR_RX
+    static const size_t COUNT     = 23040; // 2 s at 115200
+    static const uint64_t BYTE_NS = 86806;
+    static const int STALLS[]     = { 10, 40, 80 };
+
+    for (int s = 0; s < 3; s++) {
+        bench::Rig rig(115200);
+        Bluetooth* bt = &rig.bt;
+
+        size_t received = 0, gaps = 0;
+        int expected    = 0;
+
+        Clock::time_point start      = Clock::now();
+        Clock::time_point next_stall = start + std::chrono::milliseconds(200);
+        std::thread thread           = producer(COUNT, BYTE_NS, [bt](uint8_t value) { bt->isrReceive(value); });
+
+        while (Clock::now() < start + std::chrono::milliseconds(2100)) {
+            if (Clock::now() >= next_stall) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(STALLS[s]));
+                next_stall += std::chrono::milliseconds(200);
+            }
+
+            int c = bt->read();
+            if (c < 0) {
+                std::this_thread::yield();
+                continue;
+            }
+
+            gaps += c != (expected & 0xFF);
+            expected = c + 1;
+            received++;
+        }
+        thread.join();
+
+        char name[48], note[96];
+        snprintf(name, sizeof(name), "ISR RX @115200, %d ms stalls", STALLS[s]);
+        snprintf(note,
+                 sizeof(note),
+                 "%zu/%zu bytes, %lu ISR overflows, %lu RX overflows, %zu gaps",
+                 received,
+                 COUNT,
+                 (unsigned long)bt->isrOverflows(),
+                 (unsigned long)bt->rxOverflows(),
+                 gaps);
+        bench::report(name, bench::Result(), note);
+    }
+#else
+    bench::report("ISR RX", bench::Result(), "built without BT_ISR_RX");
+#endif
+}
@@ -0,0 +1,234 @@
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <string>
+
+namespace
+{
+    /**
+     * Radio side of the module, see JDY31Config.
+     */
+    struct LinkModel {
+            const char* name;
+            uint32_t rate;
+            uint32_t buffer;
+            uint32_t loss_ppm;
+    };
+
+    const LinkModel LINKS[] = {
+        { "slow link", 600, 64, 0 },
+        { "fast link", 2000, 256, 100 },
+    };
+
+    // Telemetry records, one every RECORD_PERIOD_MS
+    const size_t RECORD_SIZES[]          = { 32, 128, 512 };
+    const int RECORDS                    = 8;
+    const unsigned long RECORD_PERIOD_MS = 500;
+
+    struct Pacing {
+            uint32_t bucket_size; // 0: not paced
+            uint32_t refill_ms;
+    };
+
+    const Pacing PACINGS[] = {
+        { 0, 0 },  { 16, 1 }, { 50, 1 }, { 128, 1 }, { 256, 1 },
+        { 16, 2 }, { 50, 2 }, { 128, 2 }, { 256, 2 },
+    };
+
+    /**
+     * Sends RECORDS records of `size` bytes the blocking way, write() and
+     * flushTx() whenever the TX queue is full, one every RECORD_PERIOD_MS,
+     * then waits for the link to drain. `blocked_us` is the time spent in
+     * write() and flushTx().
+     */
+    bench::Result send(const LinkModel& link, const Pacing& pacing, size_t size, size_t* delivered, uint64_t* blocked_us)
+    {
+        JDY31Sim::Config config = bench::Rig::withBaud(JDY31Sim::Config(), 115200);
+        config.link_rate        = link.rate;
+        config.link_buffer      = link.buffer;
+        config.link_loss_ppm    = link.loss_ppm;
+
+        bench::Rig rig(115200, config);
+        rig.module.connectPeer(bench::PEER_MAC);
+        rig.bt.waitForConnection(2000);
+
+        rig.bt.using_le_device = pacing.bucket_size > 0;
+        if (rig.bt.using_le_device)
+            rig.bt.setRateLimit(pacing.bucket_size, pacing.refill_ms);
+
+        std::string payload;
+        while (payload.size() < size)
+            payload += "T=23.51;H=41.20;P=1013.2\r\n";
+        payload.resize(size);
+
+        *blocked_us = 0;
+
+        bench::Result r = bench::measure([&]() {
+            unsigned long start = millis();
+
+            for (int record = 0; record < RECORDS; record++) {
+                unsigned long due = start + record * RECORD_PERIOD_MS;
+                if (millis() < due)
+                    delay(due - millis());
+
+                uint64_t begun = host::now();
+                size_t written = 0;
+
+                while (written < size) {
+                    size_t n = rig.bt.write((const uint8_t*)payload.data() + written, size - written);
+                    written += n;
+                    if (n == 0)
+                        rig.bt.flushTx(10000);
+                }
+                rig.bt.flushTx(10000);
+                rig.uart.flush();
+
+                *blocked_us += host::now() - begun;
+            }
+
+            if (rig.module.linkIdleAt() > host::now())
+                delay((rig.module.linkIdleAt() - host::now() + 999) / 1000);
+        });
+
+        *delivered = rig.module.peerReceived().size();
+        return r;
+    }
+}
+
+/**
+ * BLE pacing settings against two simulated links at 115200.
+ *
+ * Every row sends RECORDS records of one size and reports the goodput
+ * while sending (bytes reaching the peer per second spent in write() and
+ * flushTx()), the share lost to the module buffer or on air, and how long
+ * the sender was blocked in total.
+ */
+BENCH(linkSweep)
+{
+    for (const LinkModel& link : LINKS) {
+        for (size_t size : RECORD_SIZES) {
+            for (const Pacing& pacing : PACINGS) {
+                size_t delivered;
+                uint64_t blocked_us;
+                bench::Result r = send(link, pacing, size, &delivered, &blocked_us);
+
+                char name[72], note[96];
+                if (pacing.bucket_size == 0)
+                    snprintf(name, sizeof(name), "%s, %zu B records, unpaced", link.name, size);
+                else
+                    snprintf(name,
+                             sizeof(name),
+                             "%s, %zu B records, bucket %lu / %lu ms",
+                             link.name,
+                             size,
+                             (unsigned long)pacing.bucket_size,
+                             (unsigned long)pacing.refill_ms);
+
+                snprintf(note,
+                         sizeof(note),
+                         "goodput %.0f B/s, lost %.1f%%, blocked %.0f ms",
+                         delivered / (blocked_us / 1000000.0),
+                         100.0 * (RECORDS * size - delivered) / (RECORDS * size),
+                         blocked_us / 1000.0);
+                bench::report(name, r, note);
+            }
+        }
+    }
+}
+
+/**
+ * Fixed 50 / 1 ms pacing against PACING_ADAPTIVE while the radio changes
+ * under a stream of 128 B records at 115200: the link runs at 2000 B/s,
+ * drops to 600 B/s for the middle third, then recovers. After every
+ * record the sender waits for the link to drain and checks what reached
+ * the peer, the way an application-level acknowledgement would, and
+ * reports it with `reportDelivered()` or `reportLoss()`.
+ */
+BENCH(adaptivePacing)
+{
+    static const size_t SIZE         = 128;
+    static const int PHASE_RECORDS   = 12;
+    static const uint32_t PHASES[]   = { 2000, 600, 2000 };
+    static const PacingMode MODES[]  = { PACING_FIXED, PACING_ADAPTIVE };
+    static const char* const NAMES[] = { "fixed 50 / 1 ms", "adaptive" };
+
+    for (int m = 0; m < 2; m++) {
+        JDY31Sim::Config config = bench::Rig::withBaud(JDY31Sim::Config(), 115200);
+        config.link_rate        = PHASES[0];
+        config.link_buffer      = 64;
+
+        bench::Rig rig(115200, config);
+        rig.module.connectPeer(bench::PEER_MAC);
+        rig.bt.waitForConnection(2000);
+
+        rig.bt.using_le_device = true;
+        rig.bt.setRateLimit(50, 1);
+        rig.bt.setPacingMode(MODES[m]);
+
+        std::string payload;
+        while (payload.size() < SIZE)
+            payload += "T=23.51;H=41.20;P=1013.2\r\n";
+        payload.resize(SIZE);
+
+        size_t delivered[3]    = { 0, 0, 0 };
+        uint64_t sending_us[3] = { 0, 0, 0 };
+        int lost_records[3]    = { 0, 0, 0 };
+
+        bench::Result r = bench::measure([&]() {
+            for (int phase = 0; phase < 3; phase++) {
+                rig.module.setLinkRate(PHASES[phase]);
+
+                for (int record = 0; record < PHASE_RECORDS; record++) {
+                    size_t before  = rig.module.peerReceived().size();
+                    uint64_t begun = host::now();
+                    size_t written = 0;
+
+                    while (written < SIZE) {
+                        size_t n = rig.bt.write((const uint8_t*)payload.data() + written, SIZE - written);
+                        written += n;
+                        if (n == 0)
+                            rig.bt.flushTx(10000);
+                    }
+                    rig.bt.flushTx(10000);
+                    rig.uart.flush();
+                    sending_us[phase] += host::now() - begun;
+
+                    if (rig.module.linkIdleAt() > host::now())
+                        delay((rig.module.linkIdleAt() - host::now() + 999) / 1000);
+
+                    size_t received = rig.module.peerReceived().size() - before;
+                    delivered[phase] += received;
+                    if (received == SIZE) {
+                        rig.bt.reportDelivered();
+                    } else {
+                        rig.bt.reportLoss();
+                        lost_records[phase]++;
+                    }
+                }
+            }
+        });
+
+        for (int phase = 0; phase < 3; phase++) {
+            char name[72], note[96];
+            snprintf(name, sizeof(name), "%s, link %lu B/s", NAMES[m], (unsigned long)PHASES[phase]);
+            snprintf(note,
+                     sizeof(note),
+                     "goodput %.0f B/s, %d/%d records short, lost %.1f%%",
+                     delivered[phase] / (sending_us[phase] / 1000000.0),
+                     lost_records[phase],
+                     PHASE_RECORDS,
+                     100.0 * (PHASE_RECORDS * SIZE - delivered[phase]) / (PHASE_RECORDS * SIZE));
+            bench::report(name, phase == 2 ? r : bench::Result(), note);
+        }
+
+        if (MODES[m] == PACING_ADAPTIVE) {
+            std::string rates;
+            for (uint8_t i = 0; i < rig.bt.pacingHistoryCount(); i++) {
+                char sample[16];
+                snprintf(sample, sizeof(sample), "%s%lu", i > 0 ? " " : "", (unsigned long)rig.bt.pacingHistory(i).rate);
+                rates += sample;
+            }
+            bench::report("  rate history (B/s)", bench::Result(), rates.c_str());
+        }
+    }
+}
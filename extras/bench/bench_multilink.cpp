@@ -0,0 +1,149 @@
+#include "bench.hpp"
+
+#include <memory>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const size_t PAYLOAD_SIZE = 1000;
+
+    /**
+     * One module on its own UART and pins. Several share the simulation,
+     * so the caller resets it once before creating them.
+     */
+    struct Link {
+            Uart uart;
+            JDY31Sim module;
+            Bluetooth bt;
+
+            Link(int index)
+                : uart(), module(uart, 10 + index, 20 + index, -1, bench::Rig::withBaud(JDY31Sim::Config(), 115200)),
+                  bt(&uart, 10 + index, 20 + index)
+            {
+                bt.begin(115200);
+                bench::attachIsr(uart, bt);
+                module.connectPeer(bench::PEER_MAC);
+            }
+    };
+
+    struct Run {
+            bench::Result result;
+            uint64_t command_us[4];
+            uint64_t done_us[4];
+            size_t delivered;
+    };
+
+    /**
+     * Every link streams PAYLOAD_SIZE bytes of telemetry to its peer (BLE
+     * pacing) and has to query the module version once on the way.
+     *
+     * `poller` false: the query is a blocking `runCommand()` on the link,
+     * the way a single-link sketch does it. `poller` true: the queries go
+     * through `BluetoothPoller::runCommand()`, which keeps every link polled.
+     */
+    Run run(int count, bool poller)
+    {
+        bench::HostReset reset;
+        std::vector<std::unique_ptr<Link>> links;
+        BluetoothPoller<4> links_poller;
+        std::string payload;
+        size_t written[4] = {};
+        bool queried[4]   = {};
+        Run out           = {};
+
+        while (payload.size() < PAYLOAD_SIZE)
+            payload += "T=23.51;H=41.20;P=1013.2\r\n";
+        payload.resize(PAYLOAD_SIZE);
+
+        for (int i = 0; i < count; i++) {
+            links.emplace_back(new Link(i));
+            links_poller.add(links[i]->bt);
+        }
+
+        for (int i = 0; i < count; i++) {
+            links[i]->bt.waitForConnection(2000);
+            links[i]->bt.using_le_device = true;
+        }
+
+        uint64_t start = host::now();
+
+        out.result = bench::measure([&]() {
+            int finished = 0;
+
+            while (finished < count) {
+                finished = 0;
+
+                for (int i = 0; i < count; i++) {
+                    Bluetooth& bt = links[i]->bt;
+
+                    // The query comes due once a quarter of the data is out
+                    if (!queried[i] && written[i] >= PAYLOAD_SIZE / 4) {
+                        uint64_t asked = host::now();
+                        queried[i]     = true;
+
+                        if (poller)
+                            links_poller.runCommand(bt, "AT+VERSION", NULL, 5000);
+                        else
+                            bt.runCommand("AT+VERSION", NULL, 5000);
+
+                        out.command_us[i] = host::now() - asked;
+                    }
+
+                    size_t room = bt.availableForWrite();
+                    if (written[i] < PAYLOAD_SIZE && room > 0)
+                        written[i] += bt.write((const uint8_t*)payload.data() + written[i],
+                                               min(room, PAYLOAD_SIZE - written[i]));
+
+                    if (written[i] == PAYLOAD_SIZE && bt.txQueued() == 0) {
+                        if (out.done_us[i] == 0)
+                            out.done_us[i] = host::now() - start;
+                        finished++;
+                    }
+                }
+
+                links_poller.poll();
+            }
+
+            for (int i = 0; i < count; i++)
+                links[i]->uart.flush();
+        });
+
+        for (int i = 0; i < count; i++)
+            out.delivered += links[i]->module.peerReceived().size();
+
+        return out;
+    }
+}
+
+/**
+ * 2 to 4 modules streaming at once while each runs a command.
+ * Reports aggregate goodput and, per link, how long its command took and
+ * when its data was all out.
+ */
+BENCH(multiLink)
+{
+    for (int count = 2; count <= 4; count++) {
+        for (int poller = 0; poller <= 1; poller++) {
+            Run r = run(count, poller);
+            char name[48], note[160];
+            int used = 0;
+
+            used += snprintf(note + used,
+                             sizeof(note) - used,
+                             "%.0f B/s |",
+                             r.delivered / (r.result.sim_us / 1000000.0));
+            for (int i = 0; i < count; i++)
+                used += snprintf(note + used,
+                                 sizeof(note) - used,
+                                 " cmd %.0f done %.0f ms%s",
+                                 r.command_us[i] / 1000.0,
+                                 r.done_us[i] / 1000.0,
+                                 i < count - 1 ? "," : "");
+
+            snprintf(name, sizeof(name), "%d links, %s", count, poller ? "poller" : "blocking command");
+            bench::report(name, r.result, note);
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#include "bench.hpp"
+#include "response_parser.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const char* const LINES[] = {
+        "+VERSION=JDY-31-V1.35", "+NAME=SENSOR-01", "+PIN=1234", "+BAUD=4", "+CONNECTING<<98:D3:31:FB:12:34", "+OK",
+    };
+    const int LINE_COUNT = sizeof(LINES) / sizeof(LINES[0]);
+
+    /**
+     * What callers did so far: copy the reply out, then strip the prefix
+     * they expect by hand and sscanf() the address.
+     */
+    int byHand(const char* line, char* value, size_t length, uint8_t mac[6])
+    {
+        static const char* const PREFIXES[] = { "+VERSION=", "+NAME=", "+PIN=", "+BAUD=", "+CONNECTING<<", "+OK" };
+        char copy[48];
+
+        strncpy(copy, line, sizeof(copy) - 1);
+        copy[sizeof(copy) - 1] = 0;
+
+        for (int i = 0; i < LINE_COUNT; i++) {
+            size_t prefix = strlen(PREFIXES[i]);
+            if (strncmp(copy, PREFIXES[i], prefix) != 0)
+                continue;
+
+            if (i == 4) {
+                unsigned int b[6];
+                if (sscanf(copy + prefix, "%2x:%2x:%2x:%2x:%2x:%2x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6)
+                    return -1;
+                for (int j = 0; j < 6; j++)
+                    mac[j] = (uint8_t)b[j];
+            } else {
+                strncpy(value, copy + prefix, length - 1);
+                value[length - 1] = 0;
+            }
+            return i;
+        }
+
+        return -1;
+    }
+
+    template <class Fn>
+    double nsPerLine(int rounds, Fn fn)
+    {
+        Clock::time_point start = Clock::now();
+        for (int round = 0; round < rounds; round++) {
+            for (int i = 0; i < LINE_COUNT; i++)
+                fn(LINES[i]);
+        }
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ((double)rounds * LINE_COUNT);
+    }
+}
+
+/**
+ * One of every reply the library reads (and the connect URC), parsed in
+ * place by ResponseParser against copying and parsing by hand. The checksum
+ * keeps the results alive.
+ */
+BENCH(responseParse)
+{
+    static const int ROUNDS = 200000;
+    volatile uint32_t checksum = 0;
+
+    double parsed = nsPerLine(ROUNDS, [&](const char* line) {
+        ModuleResponse response;
+        if (ResponseParser::parse(line, strlen(line), &response))
+            checksum = checksum + response.kind + response.value.length + response.mac[5];
+    });
+
+    double by_hand = nsPerLine(ROUNDS, [&](const char* line) {
+        char value[32];
+        uint8_t mac[6] = {};
+        checksum       = checksum + byHand(line, value, sizeof(value), mac) + value[0] + mac[5];
+    });
+
+    char note[64];
+    snprintf(note, sizeof(note), "%.1f ns/line", parsed);
+    bench::report("ResponseParser::parse", bench::Result(), note);
+    snprintf(note, sizeof(note), "%.1f ns/line", by_hand);
+    bench::report("  copy + strncmp + sscanf", bench::Result(), note);
+
+    // Through the library: views into the config cache, MAC from the URC
+    bench::Rig rig(9600);
+
+    BtStringView version, name;
+    long baud    = 0;
+    bool connect = false;
+
+    rig.module.connectPeer(bench::PEER_MAC);
+
+    bench::Result r = bench::measure([&]() {
+        while (!connect && millis() < 2000)
+            connect = rig.bt.handlNewConnection();
+        version = rig.bt.versionView();
+        name    = rig.bt.nameView();
+        baud    = rig.bt.moduleBaud();
+    });
+
+    snprintf(note,
+             sizeof(note),
+             "%.*s, %.*s, %ld, peer %s",
+             version.length,
+             version.data,
+             name.length,
+             name.data,
+             baud,
+             connect && memcmp(rig.bt.client_mac, bench::PEER_MAC, 6) == 0 ? "98:D3:31:FB:12:34" : "not seen");
+    bench::report("versionView/nameView/moduleBaud", r, note);
+}
@@ -0,0 +1,238 @@
+#include "bench.hpp"
+
+#include <stdio.h>
+
+namespace
+{
+    /**
+     * A module behind a power switch, off until powered. With `power_pin`
+     * -1 the driver leaves the switch to the caller, without `begun` the
+     * driver is not started.
+     */
+    struct PoweredRig {
+            bench::HostReset host_reset;
+            Uart uart;
+            JDY31Sim module;
+            Bluetooth bt;
+
+            PoweredRig(unsigned long baud, int power_pin = bench::POWER_PIN, bool begun = true)
+                : uart(),
+                  module(uart,
+                         bench::CMD_PIN,
+                         bench::STATE_PIN,
+                         bench::POWER_PIN,
+                         bench::Rig::withBaud(JDY31Sim::Config(), baud)),
+                  bt(&uart, bench::CMD_PIN, bench::STATE_PIN, power_pin)
+            {
+                if (begun)
+                    bt.begin(baud);
+                bench::attachIsr(uart, bt);
+            }
+    };
+}
+
+/**
+ * Power on until the module answers AT+VERSION: the former fixed 500 ms
+ * delay against `powerOn()` watching for the first reply, against the
+ * command queued while the module boots. A command submitted after
+ * `powerOff()` waits for `requestPowerOn()`, one submitted in a duty-cycle
+ * off window powers the module on. Before `begin()` there is no baud to
+ * probe at, so `powerOn()` waits out BT_BOOT_TIMEOUT_MS without sending.
+ */
+BENCH(wake)
+{
+    static const unsigned long RATES[] = { 9600, 115200 };
+
+    for (int i = 0; i < 2; i++) {
+        {
+            PoweredRig rig(RATES[i], -1);
+            CommandStatus status;
+
+            bench::Result r = bench::measure([&]() {
+                digitalWrite(bench::POWER_PIN, HIGH);
+                delay(500);
+                status = rig.bt.runCommand("AT+VERSION", NULL, 5000);
+            });
+
+            char name[48];
+            snprintf(name, sizeof(name), "wake, fixed 500 ms @%lu", RATES[i]);
+            bench::report(name, r, status == COMMAND_DONE ? "answered" : "no answer");
+        }
+
+        {
+            PoweredRig rig(RATES[i]);
+            CommandStatus status;
+
+            bench::Result r = bench::measure([&]() {
+                rig.bt.powerOn();
+                status = rig.bt.runCommand("AT+VERSION", NULL, 5000);
+            });
+
+            char name[48], note[64];
+            snprintf(name, sizeof(name), "  powerOn() @%lu", RATES[i]);
+            snprintf(note,
+                     sizeof(note),
+                     "%s, ready after %lu ms",
+                     status == COMMAND_DONE ? "answered" : "no answer",
+                     rig.bt.wakeLatency());
+            bench::report(name, r, note);
+        }
+
+        {
+            PoweredRig rig(RATES[i]);
+            CommandStatus status;
+
+            bench::Result r = bench::measure([&]() {
+                rig.bt.requestPowerOn();
+                int handle = rig.bt.submitCommand("AT+VERSION", NULL, 5000);
+                while ((status = rig.bt.commandStatus(handle)) == COMMAND_QUEUED || status == COMMAND_RUNNING)
+                    rig.bt.poll();
+            });
+
+            char name[48], note[64];
+            snprintf(name, sizeof(name), "  requestPowerOn() + submit @%lu", RATES[i]);
+            snprintf(note,
+                     sizeof(note),
+                     "%s, ready after %lu ms",
+                     status == COMMAND_DONE ? "answered" : "no answer",
+                     rig.bt.wakeLatency());
+            bench::report(name, r, note);
+        }
+
+        {
+            PoweredRig rig(RATES[i]);
+            CommandStatus status;
+            bool held;
+
+            rig.bt.powerOn();
+            rig.bt.powerOff();
+
+            bench::Result r = bench::measure([&]() {
+                int handle = rig.bt.submitCommand("AT+VERSION", NULL, 5000);
+                for (unsigned long start = millis(); millis() - start < 100;)
+                    rig.bt.poll();
+                held = rig.bt.powerState() == POWER_OFF && rig.bt.commandStatus(handle) == COMMAND_QUEUED;
+
+                rig.bt.requestPowerOn();
+                while ((status = rig.bt.commandStatus(handle)) == COMMAND_QUEUED || status == COMMAND_RUNNING)
+                    rig.bt.poll();
+            });
+
+            char name[48], note[64];
+            snprintf(name, sizeof(name), "  held 100 ms after powerOff() @%lu", RATES[i]);
+            snprintf(note,
+                     sizeof(note),
+                     "%s, %s, ready after %lu ms",
+                     held ? "held" : "not held",
+                     status == COMMAND_DONE ? "answered" : "no answer",
+                     rig.bt.wakeLatency());
+            bench::report(name, r, note);
+        }
+
+        {
+            PoweredRig rig(RATES[i]);
+            CommandStatus status;
+
+            // No on time: the cycle powers the module off once it is idle
+            rig.bt.setDutyCycle(0, 60000);
+            rig.bt.powerOn();
+            while (rig.bt.powerState() != POWER_OFF)
+                rig.bt.poll();
+
+            bench::Result r = bench::measure([&]() {
+                int handle = rig.bt.submitCommand("AT+VERSION", NULL, 5000);
+                while ((status = rig.bt.commandStatus(handle)) == COMMAND_QUEUED || status == COMMAND_RUNNING)
+                    rig.bt.poll();
+            });
+
+            char name[48], note[64];
+            snprintf(name, sizeof(name), "  submit in an off window @%lu", RATES[i]);
+            snprintf(note,
+                     sizeof(note),
+                     "%s, ready after %lu ms",
+                     status == COMMAND_DONE ? "answered" : "no answer",
+                     rig.bt.wakeLatency());
+            bench::report(name, r, note);
+        }
+    }
+
+    {
+        PoweredRig rig(9600, bench::POWER_PIN, false);
+
+        bench::Result r = bench::measure([&]() { rig.bt.powerOn(); });
+
+        char note[64];
+        snprintf(note, sizeof(note), "%u bytes sent, ready after %lu ms", rig.uart.tx_bytes, rig.bt.wakeLatency());
+        bench::report("powerOn() before begin()", r, note);
+    }
+}
+
+/**
+ * One simulated minute of duty cycling at 9600, 2 s on and 8 s off, driven
+ * by `poll()` only. A peer connects during the third on window and stays
+ * for 5 s, which keeps the module awake past its window.
+ */
+BENCH(dutyCycle)
+{
+    PoweredRig rig(9600);
+    int wakes = 0, ready_ms = 0;
+    uint64_t on_us = 0, longest = 0;
+    unsigned long connected_for = 0;
+    bool peer_done = false;
+
+    rig.bt.setDutyCycle(2000, 8000);
+
+    bench::Result r = bench::measure([&]() {
+        unsigned long start  = millis();
+        PowerState last      = POWER_OFF;
+        uint64_t last_change = host::now();
+        unsigned long since  = 0;
+
+        while (millis() - start < 60000) {
+            uint64_t call = host::now();
+            rig.bt.poll();
+            if (host::now() - call > longest)
+                longest = host::now() - call;
+
+            PowerState state = rig.bt.powerState();
+            if (state != last) {
+                if (last == POWER_OFF) {
+                    wakes++;
+                    last_change = host::now();
+                } else if (state == POWER_OFF) {
+                    on_us += host::now() - last_change;
+                }
+                if (state == POWER_READY)
+                    ready_ms += rig.bt.wakeLatency();
+                last = state;
+            }
+
+            if (wakes == 3 && state == POWER_READY && !peer_done) {
+                peer_done = true;
+                rig.module.connectPeer(bench::PEER_MAC);
+                rig.module.disconnectPeer(5600000);
+            }
+
+            if (rig.bt.isConnected() && since == 0)
+                since = millis();
+            else if (!rig.bt.isConnected() && since != 0) {
+                connected_for += millis() - since;
+                since = 0;
+            }
+        }
+
+        if (last != POWER_OFF)
+            on_us += host::now() - last_change;
+    });
+
+    char note[128];
+    snprintf(note,
+             sizeof(note),
+             "%d wakes, avg ready %d ms, on %.1f%%, connected %lu ms, worst poll %llu us",
+             wakes,
+             wakes > 0 ? ready_ms / wakes : 0,
+             100.0 * on_us / r.sim_us,
+             connected_for,
+             (unsigned long long)longest);
+    bench::report("duty cycle 2 s / 8 s (9600)", r, note);
+}
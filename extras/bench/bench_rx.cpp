@@ -0,0 +1,228 @@
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+/**
+ * Peer streams telemetry lines while the firmware drains them with
+ * readBytesUntil(). Reports the host cost per received byte, which covers
+ * the URC scan and the copy out of the RX buffer.
+ */
+BENCH(rxLines)
+{
+    bench::Rig rig(115200);
+    rig.bt.listen_for_urc = true;
+    rig.module.connectPeer(bench::PEER_MAC);
+    rig.bt.waitForConnection(2000);
+
+    std::string payload;
+    for (int i = 0; i < 200; i++)
+        payload += "T=23.51;H=41.20;P=1013.2;CONNECTED?\r\n";
+
+    size_t recvd = 0;
+    int lines    = 0;
+    char line[64];
+
+    rig.module.peerSend(payload.c_str());
+    rig.bt.setTimeout(50);
+
+    bench::Result r = bench::measure([&]() {
+        while (recvd < payload.size()) {
+            size_t n = rig.bt.readBytesUntil('\n', line, sizeof(line));
+            if (n == 0)
+                break;
+            recvd += n + 1;
+            lines++;
+        }
+    });
+
+    char note[64];
+    snprintf(note,
+             sizeof(note),
+             "%d lines, %.1f ns/byte, connected=%d",
+             lines,
+             (double)r.wall_ns / recvd,
+             rig.bt.isConnected());
+    bench::report("rxLines (115200)", r, note);
+}
+
+namespace
+{
+    void countLine(Bluetooth* bt, const char* line, size_t length, bool overflow, void* ctx)
+    {
+        (void)bt;
+        (void)line;
+        (void)length;
+        if (!overflow)
+            (*(int*)ctx)++;
+    }
+}
+
+/**
+ * A telemetry line from the peer every 100 ms at 9600, read for one second.
+ * The figure that matters is the longest single call, i.e. how long the
+ * main loop is held up waiting for a line.
+ */
+BENCH(rxLineAssembler)
+{
+    static const char LINE[] = "T=23.51;H=41.20;P=1013.2\r\n";
+
+    for (int mode = 0; mode < 3; mode++) {
+        bench::Rig rig(9600);
+        rig.module.connectPeer(bench::PEER_MAC);
+        rig.bt.waitForConnection(2000);
+        delay(50);
+        while (rig.bt.available() > 0)
+            rig.bt.read();
+
+        for (int i = 0; i < 10; i++)
+            host::schedule(host::now() + i * 100000, [&rig]() { rig.module.peerSend(LINE); });
+
+        int lines        = 0;
+        uint64_t longest = 0;
+        char line[64];
+
+        if (mode == 2)
+            rig.bt.setLineHandler(countLine, &lines);
+        rig.bt.setTimeout(1000);
+
+        bench::Result r = bench::measure([&]() {
+            unsigned long start = millis();
+            while (millis() - start < 1000) {
+                uint64_t call = host::now();
+
+                if (mode == 0 && rig.bt.readLine(line, sizeof(line)) > 0)
+                    lines++;
+                else if (mode == 1 && rig.bt.pollLine(line, sizeof(line)) >= 0)
+                    lines++;
+                else if (mode == 2)
+                    rig.bt.poll();
+
+                if (host::now() - call > longest)
+                    longest = host::now() - call;
+            }
+        });
+
+        static const char* const names[] = { "readLine (blocking)", "pollLine", "poll + line handler" };
+        char note[64];
+        snprintf(note, sizeof(note), "%d lines, longest call %llu us", lines, (unsigned long long)longest);
+        bench::report(names[mode], r, note);
+    }
+}
+
+namespace
+{
+    struct LinkEvents {
+            int connects;
+            int disconnects;
+            uint64_t disconnect_at;
+            uint64_t reacted_us;
+    };
+
+    void linkUp(Bluetooth* bt, const char* line, void* ctx)
+    {
+        (void)bt;
+        (void)line;
+        ((LinkEvents*)ctx)->connects++;
+    }
+
+    void linkDown(Bluetooth* bt, const char* line, void* ctx)
+    {
+        (void)bt;
+        (void)line;
+        LinkEvents* events = (LinkEvents*)ctx;
+        events->disconnects++;
+        events->reacted_us = host::now() - events->disconnect_at;
+    }
+}
+
+/**
+ * The peer connects, sends a telemetry line every 100 ms, drops the link
+ * half way through and reconnects. The firmware only calls pollLine(): connection
+ * changes arrive through the handlers and no URC line reaches the data.
+ */
+BENCH(urcEvents)
+{
+    static const char LINE[] = "T=23.51;H=41.20;P=1013.2\r\n";
+
+    bench::Rig rig(9600);
+    LinkEvents events     = {};
+    rig.bt.listen_for_urc = true;
+
+    rig.bt.onConnect(linkUp, &events);
+    rig.bt.onDisconnect(linkDown, &events);
+    rig.module.connectPeer(bench::PEER_MAC);
+
+    uint64_t start = host::now();
+    for (int i = 7; i < 25; i++)
+        host::schedule(start + i * 100000, [&rig]() { rig.module.peerSend(LINE); });
+
+    events.disconnect_at = start + 1250000;
+    rig.module.disconnectPeer(1250000);
+    rig.module.connectPeer(bench::PEER_MAC, 1300000);
+
+    int lines = 0, leaked = 0;
+    char line[64];
+
+    bench::Result r = bench::measure([&]() {
+        unsigned long begun = millis();
+        while (millis() - begun < 2500) {
+            if (rig.bt.pollLine(line, sizeof(line)) < 0)
+                continue;
+
+            lines++;
+            if (strstr(line, "CONNECT") != NULL || strstr(line, "+DISC") != NULL)
+                leaked++;
+        }
+    });
+
+    char note[96];
+    snprintf(note,
+             sizeof(note),
+             "%d lines, %d URC lines in data, %d connects, %d disconnects (handler after %.1f ms)",
+             lines,
+             leaked,
+             events.connects,
+             events.disconnects,
+             events.reacted_us / 1000.0);
+    bench::report("pollLine + URC handlers (9600)", r, note);
+}
+
+/**
+ * The peer's message ends in "\nC", which could be the start of a
+ * "CONNECTED" URC. The 'C' is held back, then released once the line has
+ * stayed quiet for as long as a URC takes to arrive.
+ */
+BENCH(urcHold)
+{
+    static const unsigned long RATES[] = { 9600, 115200 };
+
+    for (int i = 0; i < 2; i++) {
+        bench::Rig rig(RATES[i]);
+        rig.bt.listen_for_urc = true;
+        rig.module.connectPeer(bench::PEER_MAC);
+        rig.bt.waitForConnection(2000);
+
+        // Drop the connection URCs
+        delay(50);
+        while (rig.bt.read() >= 0) {
+        }
+
+        rig.module.peerSend("ok\nC");
+        unsigned long sent = millis();
+        int got            = 0;
+
+        bench::Result r = bench::measure([&]() {
+            while (got < 4 && millis() - sent < 1000) {
+                rig.bt.poll();
+                got = rig.bt.available();
+            }
+        });
+
+        char name[48], note[64];
+        snprintf(name, sizeof(name), "held URC prefix released @%lu", RATES[i]);
+        snprintf(note, sizeof(note), "%d/4 bytes readable after %lu ms", got, millis() - sent);
+        bench::report(name, r, note);
+    }
+}
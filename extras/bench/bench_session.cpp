@@ -0,0 +1,204 @@
+#include "bench.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace
+{
+    void settle(bench::Rig& rig)
+    {
+        while (rig.bt.commandPending())
+            rig.bt.poll();
+        // Let the engine leave command mode
+        unsigned long until = millis() + 200;
+        while (millis() < until)
+            rig.bt.poll();
+    }
+
+    void note(bench::Rig& rig, char* buffer, size_t length)
+    {
+        snprintf(buffer,
+                 length,
+                 "name=%s pin=%s resets=%lu pin edges=%lu",
+                 rig.module.name().c_str(),
+                 rig.module.pin().c_str(),
+                 (unsigned long)rig.module.counters.resets,
+                 (unsigned long)rig.module.counters.cmd_edges);
+    }
+}
+
+/**
+ * Provisioning a unit: name, pin and a version check.
+ */
+BENCH(provisionHelpers)
+{
+    bench::Rig rig(9600);
+    char version[32], text[96];
+
+    bench::Result r = bench::measure([&]() {
+        rig.bt.setName((char*)"SENSOR-01");
+        rig.bt.setPin((char*)"4321");
+        rig.bt.getVersion(version, sizeof(version));
+    });
+
+    note(rig, text, sizeof(text));
+    bench::report("provision, one by one", r, text);
+}
+
+BENCH(provisionSession)
+{
+    bench::Rig rig(9600);
+    char version[32], text[96];
+
+    bench::Result r = bench::measure([&]() {
+        {
+            BluetoothCommandSession session(rig.bt);
+            rig.bt.setName((char*)"SENSOR-01");
+            rig.bt.setPin((char*)"4321");
+            rig.bt.getVersion(version, sizeof(version));
+        }
+        settle(rig);
+    });
+
+    note(rig, text, sizeof(text));
+    bench::report("provision, session", r, text);
+}
+
+BENCH(provisionPipelined)
+{
+    bench::Rig rig(9600);
+    char text[96];
+
+    bench::Result r = bench::measure([&]() {
+        rig.bt.beginCommandSession();
+        rig.bt.submitCommand("AT+NAME", "SENSOR-01", 1000);
+        rig.bt.submitCommand("AT+PIN", "4321", 1000);
+        rig.bt.submitCommand("AT+VERSION", NULL, 1000);
+        rig.bt.submitCommand("AT+RESET", NULL, 1000);
+        rig.bt.endCommandSession();
+        settle(rig);
+    });
+
+    note(rig, text, sizeof(text));
+    bench::report("provision, session pipelined", r, text);
+}
+
+/**
+ * Name, pin and baud rate (9600 to 115200) changed with the setters, each
+ * resetting the module, and staged then applied with `applyConfig()`.
+ */
+BENCH(provisionConfig)
+{
+    char text[128];
+
+    {
+        bench::Rig rig(9600);
+        bool ok = false;
+
+        bench::Result r = bench::measure([&]() {
+            ok = rig.bt.setName((char*)"SENSOR-01") && rig.bt.setPin((char*)"4321");
+            rig.bt.setBaud(115200);
+        });
+
+        note(rig, text, sizeof(text));
+        snprintf(text + strlen(text), sizeof(text) - strlen(text), " baud=%lu", rig.module.baud());
+        bench::report(ok ? "config, setters" : "config, setters (failed)", r, text);
+    }
+
+    {
+        bench::Rig rig(9600);
+        ApplyStatus status = APPLY_INVALID;
+
+        BluetoothConfig config;
+        config.setName("SENSOR-01");
+        config.setPin("4321");
+        config.setBaud(115200);
+
+        bench::Result r = bench::measure([&]() { status = rig.bt.applyConfig(config); });
+
+        note(rig, text, sizeof(text));
+        snprintf(text + strlen(text), sizeof(text) - strlen(text), " baud=%lu", rig.module.baud());
+        bench::report(status == APPLY_DONE ? "config, applyConfig" : "config, applyConfig (failed)", r, text);
+    }
+}
+
+/**
+ * Five separate commands with the fixed 150 ms settle against the learned one,
+ * then the learned one against a module whose probe replies come late.
+ */
+BENCH(settle)
+{
+    static const unsigned long bauds[] = { 9600, 115200 };
+    static const SettleMode modes[]    = { SETTLE_FIXED, SETTLE_ADAPTIVE };
+
+    for (size_t b = 0; b < sizeof(bauds) / sizeof(bauds[0]); b++) {
+        for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+            bench::Rig rig(bauds[b]);
+            int ok = 0;
+
+            rig.bt.setSettleMode(modes[m]);
+            bench::Result r = bench::measure([&]() {
+                for (int i = 0; i < 5; i++)
+                    ok += rig.bt.runCommand("AT+VERSION", NULL, 1000) == COMMAND_DONE;
+            });
+
+            char name[48], text[96];
+            snprintf(name,
+                     sizeof(name),
+                     "settle %s @%lu",
+                     modes[m] == SETTLE_FIXED ? "fixed" : "adaptive",
+                     bauds[b]);
+            snprintf(text,
+                     sizeof(text),
+                     "%d/5 ok, learned %lu ms (module needs %.1f ms)",
+                     ok,
+                     rig.bt.learnedSettleTime(bauds[b]),
+                     rig.module.settleTime(bauds[b]) / 1000.0);
+            bench::report(name, r, text);
+        }
+    }
+
+    // Slow to reply: probes are answered after the driver gave up on them
+    JDY31Sim::Config slow;
+    slow.processing_us = 20000;
+
+    bench::Rig rig(115200, slow);
+    char reply[32];
+    int ok = 0;
+
+    bench::Result r = bench::measure([&]() {
+        for (int i = 0; i < 5; i++)
+            ok += rig.bt.runCommand(AT_NAME, NULL, 1000, reply, sizeof(reply)) == COMMAND_DONE
+                  && strncmp(reply, "+NAME=", 6) == 0;
+    });
+
+    char text[96];
+    snprintf(text, sizeof(text), "%d/5 answered with the name, learned %lu ms", ok, rig.bt.learnedSettleTime(115200));
+    bench::report("settle adaptive @115200, slow replies", r, text);
+}
+
+/**
+ * A few queries, a connection and some traffic, then the driver's own
+ * counters. Build with -DBT_STATS=1 to see them.
+ */
+BENCH(stats)
+{
+    bench::Rig rig(115200);
+    char version[32], name[32];
+
+    bench::Result r = bench::measure([&]() {
+        rig.bt.getVersion(version, sizeof(version));
+        rig.bt.getName(name, sizeof(name));
+        rig.module.connectPeer(bench::PEER_MAC, 200000);
+        rig.bt.waitForConnection(2000);
+        rig.bt.using_le_device = true;
+        for (int i = 0; i < 20; i++)
+            rig.bt.println("T=23.51;H=41.20;P=1013.2");
+        rig.bt.flushTx(2000);
+    });
+
+    bench::report("stats", r, BT_STATS ? "" : "built without BT_STATS");
+    host::echo_console = true;
+    rig.bt.dumpStats(Serial);
+    host::echo_console = false;
+}
@@ -0,0 +1,378 @@
+#include "bench.hpp"
+#include "bucket.hpp"
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+namespace
+{
+    const size_t PAYLOAD_SIZE = 1000;
+
+    std::string telemetry(size_t size)
+    {
+        std::string payload;
+        while (payload.size() < size)
+            payload += "T=23.51;H=41.20;P=1013.2\r\n";
+        payload.resize(size);
+        return payload;
+    }
+
+    void connect(bench::Rig& rig)
+    {
+        rig.module.connectPeer(bench::PEER_MAC);
+        rig.bt.waitForConnection(2000);
+        rig.bt.using_le_device = true;
+    }
+}
+
+/**
+ * The old BLE write path: one blocking token request per byte.
+ */
+BENCH(txBlockingBucket)
+{
+    bench::Rig rig(115200);
+    connect(rig);
+
+    std::string payload = telemetry(PAYLOAD_SIZE);
+    Bucket bucket(50, 1);
+
+    bench::Result r = bench::measure([&]() {
+        for (size_t i = 0; i < payload.size(); i++) {
+            bucket.request_token();
+            rig.uart.write((uint8_t)payload[i]);
+        }
+        rig.uart.flush();
+    });
+
+    char note[64];
+    snprintf(note, sizeof(note), "%zu bytes, caller blocked throughout", payload.size());
+    bench::report("tx blocking bucket (BLE)", r, note);
+}
+
+/**
+ * Queued path: write() returns at once, poll() paces the queue out.
+ * Reports how long the caller is held by write() and by each poll().
+ */
+BENCH(txQueue)
+{
+    bench::Rig rig(115200);
+    connect(rig);
+
+    std::string payload = telemetry(PAYLOAD_SIZE);
+    size_t written      = 0;
+    uint64_t in_write   = 0;
+    uint64_t worst_poll = 0;
+
+    bench::Result r = bench::measure([&]() {
+        while (written < payload.size() || rig.bt.txQueued() > 0) {
+            size_t room = rig.bt.availableForWrite();
+            if (written < payload.size() && room > 0) {
+                size_t chunk   = min(room, payload.size() - written);
+                uint64_t start = host::now();
+                written += rig.bt.write((const uint8_t*)payload.data() + written, chunk);
+                in_write += host::now() - start;
+            }
+
+            uint64_t start = host::now();
+            rig.bt.poll();
+            if (host::now() - start > worst_poll)
+                worst_poll = host::now() - start;
+        }
+        rig.uart.flush();
+    });
+
+    char note[96];
+    snprintf(note,
+             sizeof(note),
+             "%zu bytes, %.3f ms in write(), worst poll %llu us, peer got %zu",
+             written,
+             in_write / 1000.0,
+             (unsigned long long)worst_poll,
+             rig.module.peerReceived().size());
+    bench::report("tx queue (BLE)", r, note);
+}
+
+namespace
+{
+    const int LINES         = 40;
+    const size_t LINE_SIZE  = 60;
+    const uint32_t LINE_GAP = 100; // ms
+
+    /**
+     * Emit a telemetry line every LINE_GAP ms, either one write(uint8_t) per
+     * byte or as one bulk write, and poll in between. Besides the overall rate,
+     * reports the cost of the write() calls alone: that is the CPU the caller
+     * spends per byte, the rest of the time it is free. The simulated figure
+     * counts clock reads (host::tick_us each), i.e. token bucket refills; the
+     * host figure includes the simulated Uart.
+     */
+    void pushLines(bench::Rig& rig, bool bulk, const char* name)
+    {
+        std::string line  = telemetry(LINE_SIZE);
+        size_t written    = 0;
+        uint64_t write_ns = 0;
+        uint64_t write_us = 0;
+
+        bench::Result r = bench::measure([&]() {
+            for (int n = 0; n < LINES; n++) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                uint64_t sim_start                          = host::now();
+                const uint8_t* data                         = (const uint8_t*)line.data();
+
+                if (bulk) {
+                    written += rig.bt.write(data, line.size());
+                } else {
+                    for (size_t i = 0; i < line.size(); i++)
+                        written += rig.bt.write(data[i]);
+                }
+
+                write_us += host::now() - sim_start;
+                write_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                                                 - start)
+                                .count();
+
+                unsigned long next = millis() + LINE_GAP;
+                while (millis() < next)
+                    rig.bt.poll();
+            }
+            rig.bt.flushTx(10000);
+            rig.uart.flush();
+        });
+
+        char note[128];
+        snprintf(note,
+                 sizeof(note),
+                 "%zu bytes, write(): %.1f host ns/byte, %.2f sim us/byte, peer got %zu",
+                 written,
+                 (double)write_ns / written,
+                 (double)write_us / written,
+                 rig.module.peerReceived().size());
+        bench::report(name, r, note);
+    }
+}
+
+BENCH(txPerByte)
+{
+    bench::Rig rig(115200);
+    connect(rig);
+    pushLines(rig, false, "tx lines, per-byte write (BLE)");
+}
+
+BENCH(txBulk)
+{
+    bench::Rig rig(115200);
+    connect(rig);
+    pushLines(rig, true, "tx lines, bulk write (BLE)");
+}
+
+namespace
+{
+    enum PrintStyle {
+        PRINT_UNBUFFERED,
+        PRINT_BUFFERED,
+        PRINT_PRINTF,
+    };
+
+    /**
+     * The telemetry line again, built from readings with print()/println()
+     * (one write per character or number, or gathered in the staging
+     * buffer) or with printf(). Reports the cost of the print calls and
+     * the Uart write() calls per line.
+     */
+    void printLines(bench::Rig& rig, PrintStyle style, const char* name)
+    {
+        const double temperature = 23.51, humidity = 41.2, pressure = 1013.2;
+        uint64_t print_ns        = 0;
+        uint64_t print_us        = 0;
+
+        rig.bt.setPrintBuffering(style != PRINT_UNBUFFERED);
+        const uint32_t writes = rig.uart.tx_writes;
+
+        bench::Result r = bench::measure([&]() {
+            for (int n = 0; n < LINES; n++) {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                uint64_t sim_start                          = host::now();
+
+                if (style == PRINT_PRINTF) {
+                    rig.bt.printf("T=%.2f;H=%.2f;P=%.1f\r\n", temperature, humidity, pressure);
+                } else {
+                    rig.bt.print("T=");
+                    rig.bt.print(temperature);
+                    rig.bt.print(";H=");
+                    rig.bt.print(humidity);
+                    rig.bt.print(";P=");
+                    rig.bt.println(pressure, 1);
+                }
+
+                print_us += host::now() - sim_start;
+                print_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()
+                                                                                 - start)
+                                .count();
+
+                unsigned long next = millis() + LINE_GAP;
+                while (millis() < next)
+                    rig.bt.poll();
+            }
+            rig.bt.flushTx(10000);
+            rig.uart.flush();
+        });
+
+        char note[128];
+        snprintf(note,
+                 sizeof(note),
+                 "%.0f host ns/line, %.1f sim us/line, %.1f Uart writes/line, peer got %zu",
+                 (double)print_ns / LINES,
+                 (double)print_us / LINES,
+                 (double)(rig.uart.tx_writes - writes) / LINES,
+                 rig.module.peerReceived().size());
+        bench::report(name, r, note);
+    }
+}
+
+BENCH(txPrint)
+{
+    const PrintStyle styles[]  = { PRINT_UNBUFFERED, PRINT_BUFFERED, PRINT_PRINTF };
+    const char* const names[]  = { "print lines, unbuffered", "print lines, staged", "printf lines, staged" };
+    const bool le_devices[]    = { false, true };
+
+    for (bool le_device : le_devices) {
+        for (int i = 0; i < 3; i++) {
+            bench::Rig rig(115200);
+            connect(rig);
+            rig.bt.using_le_device = le_device;
+
+            char name[48];
+            snprintf(name, sizeof(name), "%s%s", names[i], le_device ? " (BLE)" : "");
+            printLines(rig, styles[i], name);
+        }
+    }
+}
+
+/**
+ * Data written while an AT+VERSION submitted with submitCommand() is
+ * still queued, or already running in command mode. It has to wait for
+ * the module to be back in data mode, on classic and BLE links alike.
+ */
+BENCH(txDuringCommand)
+{
+    const bool le_devices[] = { false, true };
+    const bool started[]    = { false, true };
+
+    for (bool le_device : le_devices) {
+        for (bool running : started) {
+            bench::Rig rig(115200);
+            connect(rig);
+            rig.bt.using_le_device = le_device;
+
+            CommandStatus status;
+
+            bench::Result r = bench::measure([&]() {
+                int handle = rig.bt.submitCommand(AT_VERSION, NULL, 1000);
+                while (running && rig.bt.commandStatus(handle) == COMMAND_QUEUED)
+                    rig.bt.poll();
+
+                rig.bt.print("hello");
+                rig.bt.write('\n');
+
+                while ((status = rig.bt.commandStatus(handle)) == COMMAND_QUEUED || status == COMMAND_RUNNING
+                       || rig.bt.txQueued() > 0)
+                    rig.bt.poll();
+                rig.uart.flush();
+            });
+
+            const std::vector<uint8_t>& received = rig.module.peerReceived();
+            const bool delivered = std::string(received.begin(), received.end()) == "hello\n";
+
+            char name[48], note[64];
+            snprintf(name,
+                     sizeof(name),
+                     "tx during %s command%s",
+                     running ? "running" : "queued",
+                     le_device ? " (BLE)" : "");
+            snprintf(note,
+                     sizeof(note),
+                     "command %s, peer %s",
+                     status == COMMAND_DONE ? "done" : "failed",
+                     delivered ? "got \"hello\"" : "missed it");
+            bench::report(name, r, note);
+        }
+    }
+}
+
+/**
+ * The legacy `sendCommand()`, which raises the command pin itself, while
+ * telemetry is still queued on a BLE link. The queue has to wait for the
+ * pin to drop, and the command must not reach the peer.
+ */
+BENCH(txLegacyCommand)
+{
+    bench::Rig rig(115200);
+    connect(rig);
+
+    std::string payload = telemetry(200);
+
+    bench::Result r = bench::measure([&]() {
+        rig.bt.write((const uint8_t*)payload.data(), payload.size());
+        rig.bt.sendCommand((char*)"AT+VERSION", 100);
+        rig.bt.flushTx(5000);
+        rig.uart.flush();
+    });
+
+    const std::vector<uint8_t>& received = rig.module.peerReceived();
+    const bool intact                    = std::string(received.begin(), received.end()) == payload;
+
+    char note[64];
+    snprintf(note, sizeof(note), "peer got %zu/%zu bytes%s", received.size(), payload.size(), intact ? ", intact" : "");
+    bench::report("sendCommand() over queued data (BLE)", r, note);
+}
+
+/**
+ * An unbuffered `printf()` into a nearly full TX queue on a BLE link, then
+ * byte writes before the next `poll()`. What the queue could not take of
+ * the line is dropped, not left staged for the bytes to overtake, so the
+ * peer sees every accepted byte once and in order.
+ */
+BENCH(txPrintfPartial)
+{
+    bench::Rig rig(115200);
+    connect(rig);
+
+    std::string payload = telemetry(PAYLOAD_SIZE);
+    std::string line    = "0123456789012345678901234567890123456789\n";
+    std::string expected;
+
+    bench::Result r = bench::measure([&]() {
+        size_t accepted = rig.bt.write((const uint8_t*)payload.data(), payload.size());
+        expected        = payload.substr(0, accepted);
+
+        while (rig.bt.availableForWrite() < 10)
+            rig.bt.poll();
+
+        accepted = rig.bt.printf("%s", line.c_str());
+        expected += line.substr(0, accepted);
+
+        // Byte writes drain the queue themselves once the bucket refills
+        delay(20);
+        for (char c : std::string("END\n")) {
+            if (rig.bt.write((uint8_t)c) == 1)
+                expected += c;
+        }
+
+        rig.bt.flushTx(5000);
+        rig.uart.flush();
+    });
+
+    const std::vector<uint8_t>& received = rig.module.peerReceived();
+    const bool in_order                  = std::string(received.begin(), received.end()) == expected;
+
+    char note[64];
+    snprintf(note,
+             sizeof(note),
+             "peer got %zu/%zu bytes, %s",
+             received.size(),
+             expected.size(),
+             in_order ? "in order" : "reordered");
+    bench::report("printf() into a full queue (BLE)", r, note);
+}
@@ -0,0 +1,94 @@
+#include "bench.hpp"
+
+#include <chrono>
+#include <stdio.h>
+
+namespace
+{
+    const int BYTES = 1000000;
+
+    /**
+     * Stream sink that only counts, so the dispatch dominates.
+     */
+    class NullStream : public Stream
+    {
+        public:
+            volatile uint8_t last = 0;
+            size_t count          = 0;
+
+            void begin(unsigned long) {}
+
+            void begin(unsigned long, uint16_t) {}
+
+            void end() {}
+
+            int available()
+            {
+                return 0;
+            }
+
+            int read()
+            {
+                return -1;
+            }
+
+            int peek()
+            {
+                return -1;
+            }
+
+            void setTimeout(long timeout)
+            {
+                Stream::setTimeout(timeout);
+            }
+
+            size_t write(uint8_t value)
+            {
+                last = value;
+                count++;
+                return 1;
+            }
+
+            using Print::write;
+    };
+
+    // Keep the dynamic type hidden from the optimizer, as a real BT_Base& parameter would be
+    __attribute__((noinline)) void writeVirtual(BT_Base& bt, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+            bt.write((uint8_t)i);
+    }
+
+    template <class BT>
+    __attribute__((noinline)) void writeStatic(BT& bt, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+            bt.write((uint8_t)i);
+    }
+
+    template <class Fn>
+    double nsPerByte(Fn fn)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count() / BYTES;
+    }
+}
+
+/**
+ * Per-byte call cost of BT_Wrapper (vtable) against BT_Static (inlined).
+ */
+BENCH(wrapperDispatch)
+{
+    NullStream sink;
+    BT_Wrapper<NullStream> dynamic(&sink);
+    BT_Static<NullStream> direct(&sink);
+
+    double virtual_ns = nsPerByte([&]() { writeVirtual(dynamic, BYTES); });
+    double static_ns  = nsPerByte([&]() { writeStatic(direct, BYTES); });
+
+    char note[96];
+    snprintf(note, sizeof(note), "BT_Wrapper %.2f ns/byte, BT_Static %.2f ns/byte", virtual_ns, static_ns);
+    bench::report("wrapper dispatch", bench::Result(), note);
+}
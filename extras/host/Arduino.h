@@ -0,0 +1,339 @@
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+/**
+ * Minimal host-side stand-in for the Arduino core.
+ *
+ * Only what this library uses is provided. Time is simulated: `delay()`
+ * advances the clock and every `millis()`/`micros()` call charges a small
+ * amount of CPU time, so busy loops terminate exactly as on a board.
+ * See host.hpp for the simulation controls.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT        0x0
+#define OUTPUT       0x1
+#define INPUT_PULLUP 0x2
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define SERIAL_8N1 0x0011
+
+#define SERIAL_BUFFER_SIZE 64
+
+#define PROGMEM
+#define PSTR(s)            (s)
+#define F(s)               (reinterpret_cast<const __FlashStringHelper*>(PSTR(s)))
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define strlen_P           strlen
+#define strcmp_P           strcmp
+#define strncmp_P          strncmp
+#define memcpy_P           memcpy
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+template <class T, class U>
+static inline auto min(const T& a, const U& b) -> decltype(a < b ? a : b)
+{
+    return (b < a) ? b : a;
+}
+
+template <class T, class U>
+static inline auto max(const T& a, const U& b) -> decltype(a < b ? a : b)
+{
+    return (a < b) ? b : a;
+}
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(int pin, int mode);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+
+
+class __FlashStringHelper;
+
+class String
+{
+    private:
+        char* _buffer;
+        size_t _len;
+
+    public:
+        String(const char* str = "");
+        String(const String& other);
+        ~String();
+
+        String& operator=(const String& other);
+
+        const char* c_str() const
+        {
+            return _buffer;
+        }
+
+        size_t length() const
+        {
+            return _len;
+        }
+};
+
+class Print;
+
+class Printable
+{
+    public:
+        virtual ~Printable() {}
+
+        virtual size_t printTo(Print& p) const = 0;
+};
+
+class Print
+{
+    private:
+        int write_error = 0;
+
+        size_t printNumber(unsigned long long n, uint8_t base);
+        size_t printFloat(double number, uint8_t digits);
+
+    protected:
+        void setWriteError(int err = 1)
+        {
+            write_error = err;
+        }
+
+    public:
+        virtual ~Print() {}
+
+        int getWriteError()
+        {
+            return write_error;
+        }
+
+        void clearWriteError()
+        {
+            setWriteError(0);
+        }
+
+        virtual size_t write(uint8_t) = 0;
+
+        size_t write(const char* str)
+        {
+            if (str == NULL)
+                return 0;
+            return write((const uint8_t*)str, strlen(str));
+        }
+
+        virtual size_t write(const uint8_t* buffer, size_t size);
+
+        size_t write(const char* buffer, size_t size)
+        {
+            return write((const uint8_t*)buffer, size);
+        }
+
+        virtual int availableForWrite()
+        {
+            return 0;
+        }
+
+        size_t print(const __FlashStringHelper* helper);
+        size_t print(const String& str);
+        size_t print(const char* str);
+        size_t print(char c);
+        size_t print(unsigned char v, int base = DEC);
+        size_t print(int v, int base = DEC);
+        size_t print(unsigned int v, int base = DEC);
+        size_t print(long v, int base = DEC);
+        size_t print(unsigned long v, int base = DEC);
+        size_t print(long long v, int base = DEC);
+        size_t print(unsigned long long v, int base = DEC);
+        size_t print(double v, int digits = 2);
+        size_t print(const Printable& printable);
+
+        size_t println(const __FlashStringHelper* helper);
+        size_t println(const String& str);
+        size_t println(const char* str);
+        size_t println(char c);
+        size_t println(unsigned char v, int base = DEC);
+        size_t println(int v, int base = DEC);
+        size_t println(unsigned int v, int base = DEC);
+        size_t println(long v, int base = DEC);
+        size_t println(unsigned long v, int base = DEC);
+        size_t println(long long v, int base = DEC);
+        size_t println(unsigned long long v, int base = DEC);
+        size_t println(double v, int digits = 2);
+        size_t println(const Printable& printable);
+        size_t println(void);
+
+        virtual void flush() {}
+};
+
+class Stream : public Print
+{
+    protected:
+        unsigned long _timeout = 1000;
+        unsigned long _startMillis;
+
+        int timedRead();
+        int timedPeek();
+
+    public:
+        virtual int available() = 0;
+        virtual int read()      = 0;
+        virtual int peek()      = 0;
+
+        Stream() {}
+
+        void setTimeout(unsigned long timeout)
+        {
+            _timeout = timeout;
+        }
+
+        unsigned long getTimeout()
+        {
+            return _timeout;
+        }
+
+        size_t readBytes(char* buffer, size_t length);
+
+        size_t readBytes(uint8_t* buffer, size_t length)
+        {
+            return readBytes((char*)buffer, length);
+        }
+
+        size_t readBytesUntil(char terminator, char* buffer, size_t length);
+};
+
+class HardwareSerial : public Stream
+{
+    public:
+        virtual void begin(unsigned long baudrate)                  = 0;
+        virtual void begin(unsigned long baudrate, uint16_t config) = 0;
+        virtual void end()                                          = 0;
+
+        virtual operator bool()
+        {
+            return true;
+        }
+};
+
+namespace host
+{
+    class UartPeer;
+}
+
+/**
+ * Simulated SERCOM UART.
+ *
+ * Bytes written are serialized at the configured baud rate through a
+ * SERIAL_BUFFER_SIZE deep TX buffer (writes block when it is full) and
+ * delivered to the attached peer. Received bytes land in a RX buffer of the
+ * same depth and are dropped, and counted, when it overflows.
+ */
+class Uart : public HardwareSerial
+{
+    private:
+        host::UartPeer* _peer = NULL;
+        void (*_rx_handler)(void* ctx) = NULL;
+        void* _rx_ctx                  = NULL;
+        uint8_t* _rx;
+        size_t _rx_size;
+        size_t _rx_head  = 0;
+        size_t _rx_count = 0;
+        size_t _tx_size;
+        size_t _tx_pending = 0;
+        unsigned long _baud = 0;
+        uint64_t _line_free_at = 0;
+
+        size_t send(uint8_t value);
+
+    public:
+        uint32_t rx_overflows = 0;
+        uint32_t rx_garbled   = 0;
+        uint32_t tx_bytes     = 0;
+        uint32_t tx_writes    = 0; // write() calls, bulk or not
+        uint32_t rx_bytes     = 0;
+
+        Uart(size_t rx_size = SERIAL_BUFFER_SIZE, size_t tx_size = SERIAL_BUFFER_SIZE);
+        ~Uart();
+
+        void begin(unsigned long baudrate);
+        void begin(unsigned long baudrate, uint16_t config);
+        void end();
+        int available();
+        int availableForWrite();
+        int peek();
+        int read();
+        void flush();
+        size_t write(uint8_t value);
+        size_t write(const uint8_t* buffer, size_t size);
+
+        using Print::write;
+
+        /**
+         * Host side: connect the other end of the wire.
+         */
+        void attach(host::UartPeer* peer);
+
+        /**
+         * Host side: a byte sent at `baud` reaches the RX pin now.
+         */
+        void receive(uint8_t value, unsigned long baud);
+
+        /**
+         * Host side: run `handler` after every byte received, the way the
+         * SERCOM RX interrupt would.
+         */
+        void onReceive(void (*handler)(void* ctx), void* ctx);
+
+        unsigned long baud() const
+        {
+            return _baud;
+        }
+};
+
+/**
+ * Console stand-in for the USB `Serial`, echoed to stdout only when
+ * `host::echo_console` is set.
+ */
+class HostConsole : public Stream
+{
+    public:
+        int available()
+        {
+            return 0;
+        }
+
+        int read()
+        {
+            return -1;
+        }
+
+        int peek()
+        {
+            return -1;
+        }
+
+        size_t write(uint8_t value);
+
+        using Print::write;
+};
+
+extern HostConsole Serial;
+
+#endif
@@ -0,0 +1,625 @@
+#include "host.hpp"
+
+#include <Arduino.h>
+#include <map>
+#include <queue>
+#include <stdio.h>
+#include <vector>
+
+namespace host
+{
+    uint32_t tick_us  = 1;
+    bool echo_console = false;
+    Stats stats;
+
+    namespace
+    {
+        struct Event {
+                uint64_t at;
+                uint64_t seq;
+                std::function<void()> fn;
+
+                bool operator>(const Event& other) const
+                {
+                    return at != other.at ? at > other.at : seq > other.seq;
+                }
+        };
+
+        struct Pin {
+                int mode   = INPUT;
+                int output = LOW;
+                int input  = LOW;
+                std::vector<std::function<void(int)>> hooks;
+        };
+
+        uint64_t clock_us = 0;
+        uint64_t next_seq = 0;
+        std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events;
+        std::map<int, Pin> pins;
+
+        void charge(uint64_t us, uint64_t& counter)
+        {
+            counter += us;
+            advance(us);
+        }
+    }
+
+    void reset()
+    {
+        clock_us = 0;
+        next_seq = 0;
+        events   = decltype(events)();
+        pins.clear();
+        stats = Stats();
+    }
+
+    uint64_t now()
+    {
+        return clock_us;
+    }
+
+    void advanceTo(uint64_t at)
+    {
+        while (!events.empty() && events.top().at <= at) {
+            Event event = events.top();
+            events.pop();
+            if (event.at > clock_us)
+                clock_us = event.at;
+            event.fn();
+        }
+        if (at > clock_us)
+            clock_us = at;
+    }
+
+    void advance(uint64_t us)
+    {
+        advanceTo(clock_us + us);
+    }
+
+    bool step()
+    {
+        if (events.empty())
+            return false;
+        advanceTo(events.top().at);
+        return true;
+    }
+
+    void schedule(uint64_t at, std::function<void()> fn)
+    {
+        events.push(Event{ at, next_seq++, fn });
+    }
+
+    void onPinWrite(int pin, std::function<void(int)> fn)
+    {
+        pins[pin].hooks.push_back(fn);
+    }
+
+    void setPinInput(int pin, int value)
+    {
+        pins[pin].input = value;
+    }
+
+    int pinOutput(int pin)
+    {
+        return pins[pin].output;
+    }
+}
+
+unsigned long millis()
+{
+    host::charge(host::tick_us, host::stats.spin_us);
+    return (unsigned long)(host::now() / 1000);
+}
+
+unsigned long micros()
+{
+    host::charge(host::tick_us, host::stats.spin_us);
+    return (unsigned long)host::now();
+}
+
+void delay(unsigned long ms)
+{
+    host::charge((uint64_t)ms * 1000, host::stats.delay_us);
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    host::charge(us, host::stats.delay_us);
+}
+
+void yield() {}
+
+void pinMode(int pin, int mode)
+{
+    if (pin < 0)
+        return;
+    host::pins[pin].mode = mode;
+}
+
+void digitalWrite(int pin, int value)
+{
+    if (pin < 0)
+        return;
+
+    host::Pin& p = host::pins[pin];
+    p.output     = value;
+    for (size_t i = 0; i < p.hooks.size(); i++)
+        p.hooks[i](value);
+}
+
+int digitalRead(int pin)
+{
+    if (pin < 0)
+        return LOW;
+
+    host::Pin& p = host::pins[pin];
+    if (p.mode == OUTPUT)
+        return p.output;
+    return p.input;
+}
+
+
+/**
+ * String
+ */
+
+String::String(const char* str)
+{
+    _len    = strlen(str);
+    _buffer = (char*)malloc(_len + 1);
+    memcpy(_buffer, str, _len + 1);
+}
+
+String::String(const String& other) : String(other.c_str()) {}
+
+String::~String()
+{
+    free(_buffer);
+}
+
+String& String::operator=(const String& other)
+{
+    if (this != &other) {
+        free(_buffer);
+        _len    = other._len;
+        _buffer = (char*)malloc(_len + 1);
+        memcpy(_buffer, other._buffer, _len + 1);
+    }
+    return *this;
+}
+
+
+/**
+ * Print
+ */
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--) {
+        if (write(*buffer++))
+            n++;
+        else
+            break;
+    }
+    return n;
+}
+
+size_t Print::printNumber(unsigned long long n, uint8_t base)
+{
+    char buf[8 * sizeof(n) + 1];
+    char* str = &buf[sizeof(buf) - 1];
+
+    *str = '\0';
+
+    if (base < 2)
+        base = 10;
+
+    do {
+        char c = n % base;
+        n /= base;
+
+        *--str = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+
+    return write(str);
+}
+
+size_t Print::printFloat(double number, uint8_t digits)
+{
+    size_t n = 0;
+
+    if (isnan(number))
+        return print("nan");
+    if (isinf(number))
+        return print("inf");
+    if (number > 4294967040.0 || number < -4294967040.0)
+        return print("ovf");
+
+    if (number < 0.0) {
+        n += print('-');
+        number = -number;
+    }
+
+    double rounding = 0.5;
+    for (uint8_t i = 0; i < digits; ++i)
+        rounding /= 10.0;
+
+    number += rounding;
+
+    unsigned long int_part = (unsigned long)number;
+    double remainder       = number - (double)int_part;
+    n += print(int_part);
+
+    if (digits > 0)
+        n += print('.');
+
+    while (digits-- > 0) {
+        remainder *= 10.0;
+        unsigned int to_print = (unsigned int)remainder;
+        n += print(to_print);
+        remainder -= to_print;
+    }
+
+    return n;
+}
+
+size_t Print::print(const __FlashStringHelper* helper)
+{
+    return write(reinterpret_cast<const char*>(helper));
+}
+
+size_t Print::print(const String& str)
+{
+    return write(str.c_str(), str.length());
+}
+
+size_t Print::print(const char* str)
+{
+    return write(str);
+}
+
+size_t Print::print(char c)
+{
+    return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char v, int base)
+{
+    return print((unsigned long)v, base);
+}
+
+size_t Print::print(int v, int base)
+{
+    return print((long)v, base);
+}
+
+size_t Print::print(unsigned int v, int base)
+{
+    return print((unsigned long)v, base);
+}
+
+size_t Print::print(long v, int base)
+{
+    return print((long long)v, base);
+}
+
+size_t Print::print(unsigned long v, int base)
+{
+    return print((unsigned long long)v, base);
+}
+
+size_t Print::print(long long v, int base)
+{
+    if (base == 0)
+        return write((uint8_t)v);
+
+    if (base == 10 && v < 0)
+        return print('-') + printNumber((unsigned long long)(-v), 10);
+
+    return printNumber((unsigned long long)v, base);
+}
+
+size_t Print::print(unsigned long long v, int base)
+{
+    if (base == 0)
+        return write((uint8_t)v);
+    return printNumber(v, base);
+}
+
+size_t Print::print(double v, int digits)
+{
+    return printFloat(v, digits);
+}
+
+size_t Print::print(const Printable& printable)
+{
+    return printable.printTo(*this);
+}
+
+size_t Print::println(void)
+{
+    return write("\r\n");
+}
+
+size_t Print::println(const __FlashStringHelper* helper)
+{
+    return print(helper) + println();
+}
+
+size_t Print::println(const String& str)
+{
+    return print(str) + println();
+}
+
+size_t Print::println(const char* str)
+{
+    return print(str) + println();
+}
+
+size_t Print::println(char c)
+{
+    return print(c) + println();
+}
+
+size_t Print::println(unsigned char v, int base)
+{
+    return print(v, base) + println();
+}
+
+size_t Print::println(int v, int base)
+{
+    return print(v, base) + println();
+}
+
+size_t Print::println(unsigned int v, int base)
+{
+    return print(v, base) + println();
+}
+
+size_t Print::println(long v, int base)
+{
+    return print(v, base) + println();
+}
+
+size_t Print::println(unsigned long v, int base)
+{
+    return print(v, base) + println();
+}
+
+size_t Print::println(long long v, int base)
+{
+    return print(v, base) + println();
+}
+
+size_t Print::println(unsigned long long v, int base)
+{
+    return print(v, base) + println();
+}
+
+size_t Print::println(double v, int digits)
+{
+    return print(v, digits) + println();
+}
+
+size_t Print::println(const Printable& printable)
+{
+    return print(printable) + println();
+}
+
+
+/**
+ * Stream
+ */
+
+int Stream::timedRead()
+{
+    int c;
+    _startMillis = millis();
+    do {
+        c = read();
+        if (c >= 0)
+            return c;
+    } while (millis() - _startMillis < _timeout);
+    return -1;
+}
+
+int Stream::timedPeek()
+{
+    int c;
+    _startMillis = millis();
+    do {
+        c = peek();
+        if (c >= 0)
+            return c;
+    } while (millis() - _startMillis < _timeout);
+    return -1;
+}
+
+size_t Stream::readBytes(char* buffer, size_t length)
+{
+    size_t count = 0;
+    while (count < length) {
+        int c = timedRead();
+        if (c < 0)
+            break;
+        *buffer++ = (char)c;
+        count++;
+    }
+    return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char* buffer, size_t length)
+{
+    size_t index = 0;
+    while (index < length) {
+        int c = timedRead();
+        if (c < 0 || c == terminator)
+            break;
+        *buffer++ = (char)c;
+        index++;
+    }
+    return index;
+}
+
+
+/**
+ * Uart
+ */
+
+Uart::Uart(size_t rx_size, size_t tx_size) : _rx_size(rx_size), _tx_size(tx_size)
+{
+    _rx = new uint8_t[rx_size];
+}
+
+Uart::~Uart()
+{
+    delete[] _rx;
+}
+
+void Uart::attach(host::UartPeer* peer)
+{
+    _peer = peer;
+}
+
+void Uart::onReceive(void (*handler)(void* ctx), void* ctx)
+{
+    _rx_handler = handler;
+    _rx_ctx     = ctx;
+}
+
+void Uart::begin(unsigned long baudrate)
+{
+    begin(baudrate, SERIAL_8N1);
+}
+
+void Uart::begin(unsigned long baudrate, uint16_t config)
+{
+    (void)config;
+    _baud     = baudrate;
+    _rx_head  = 0;
+    _rx_count = 0;
+}
+
+void Uart::end()
+{
+    flush();
+    _baud     = 0;
+    _rx_count = 0;
+}
+
+int Uart::available()
+{
+    return (int)_rx_count;
+}
+
+int Uart::availableForWrite()
+{
+    return (int)(_tx_size - _tx_pending);
+}
+
+int Uart::peek()
+{
+    if (_rx_count == 0)
+        return -1;
+    return _rx[_rx_head];
+}
+
+int Uart::read()
+{
+    if (_rx_count == 0)
+        return -1;
+
+    uint8_t value = _rx[_rx_head];
+    _rx_head      = (_rx_head + 1) % _rx_size;
+    _rx_count--;
+    return value;
+}
+
+void Uart::flush()
+{
+    uint64_t start = host::now();
+    while (_tx_pending > 0 && host::step()) {
+    }
+    host::stats.block_us += host::now() - start;
+}
+
+size_t Uart::write(uint8_t value)
+{
+    tx_writes++;
+    return send(value);
+}
+
+size_t Uart::write(const uint8_t* buffer, size_t size)
+{
+    size_t sent = 0;
+
+    tx_writes++;
+    while (sent < size && send(buffer[sent]))
+        sent++;
+    return sent;
+}
+
+size_t Uart::send(uint8_t value)
+{
+    if (_baud == 0)
+        return 0;
+
+    if (_tx_pending >= _tx_size) {
+        uint64_t start = host::now();
+        while (_tx_pending >= _tx_size && host::step()) {
+        }
+        host::stats.block_us += host::now() - start;
+    }
+
+    uint64_t start     = _line_free_at > host::now() ? _line_free_at : host::now();
+    _line_free_at      = start + host::byteTime(_baud);
+    unsigned long baud = _baud;
+    _tx_pending++;
+    tx_bytes++;
+
+    host::schedule(_line_free_at, [this, value, baud]() {
+        _tx_pending--;
+        if (_peer != NULL)
+            _peer->receive(value, baud);
+    });
+    return 1;
+}
+
+void Uart::receive(uint8_t value, unsigned long baud)
+{
+    if (_baud == 0)
+        return;
+
+    if (baud != _baud) {
+        // Framing errors: what comes out of the shift register is noise
+        value = (uint8_t)(~value | 0x80);
+        rx_garbled++;
+    }
+
+    if (_rx_count >= _rx_size) {
+        rx_overflows++;
+        return;
+    }
+
+    _rx[(_rx_head + _rx_count) % _rx_size] = value;
+    _rx_count++;
+    rx_bytes++;
+
+    if (_rx_handler != NULL)
+        _rx_handler(_rx_ctx);
+}
+
+
+/**
+ * Console
+ */
+
+HostConsole Serial;
+
+size_t HostConsole::write(uint8_t value)
+{
+    if (host::echo_console)
+        putchar(value);
+    return 1;
+}
@@ -0,0 +1,89 @@
+#ifndef HOST_SIM_HPP
+#define HOST_SIM_HPP
+
+#include <Arduino.h>
+#include <functional>
+#include <stdint.h>
+
+/**
+ * Simulation controls for the host build.
+ *
+ * All time is virtual and counted in microseconds. Work scheduled with
+ * `schedule()` runs when the clock is advanced past it, either by `delay()`,
+ * by the per-call cost charged to `millis()`/`micros()`, or by `advance()`.
+ */
+namespace host
+{
+    /**
+     * The far end of a simulated UART wire.
+     */
+    class UartPeer
+    {
+        public:
+            virtual ~UartPeer() {}
+
+            virtual void receive(uint8_t value, unsigned long baud) = 0;
+    };
+
+    struct Stats {
+            uint64_t delay_us = 0;  // time spent in delay()/delayMicroseconds()
+            uint64_t spin_us  = 0;  // time charged to busy loops polling the clock
+            uint64_t block_us = 0;  // time spent blocked in Uart::write()/flush()
+    };
+
+    /**
+     * Virtual CPU time charged per `millis()`/`micros()` call.
+     */
+    extern uint32_t tick_us;
+
+    /**
+     * Echo `Serial` output to stdout.
+     */
+    extern bool echo_console;
+
+    extern Stats stats;
+
+    /**
+     * Clear the clock, pending events, pin state and stats.
+     */
+    void reset();
+
+    uint64_t now();
+
+    /**
+     * Advance the clock by `us`, running every event that falls due.
+     */
+    void advance(uint64_t us);
+
+    void advanceTo(uint64_t at);
+
+    /**
+     * Jump to the next pending event and run it.
+     * Returns false if nothing is pending.
+     */
+    bool step();
+
+    void schedule(uint64_t at, std::function<void()> fn);
+
+    /**
+     * Register a callback run whenever the firmware writes `pin`.
+     */
+    void onPinWrite(int pin, std::function<void(int)> fn);
+
+    /**
+     * Drive the level the firmware reads on `pin`.
+     */
+    void setPinInput(int pin, int value);
+
+    int pinOutput(int pin);
+
+    /**
+     * Time one byte takes on the wire at `baud` (8N1).
+     */
+    inline uint32_t byteTime(unsigned long baud)
+    {
+        return (uint32_t)((10UL * 1000000UL + baud - 1) / baud);
+    }
+}
+
+#endif
@@ -0,0 +1,284 @@
+#include "jdy31_sim.hpp"
+
+#include <stdio.h>
+
+const unsigned long JDY31Sim::RATES[6] = { 9600, 19200, 38400, 57600, 115200, 128000 };
+
+JDY31Sim::JDY31Sim(Uart& uart, int cmd_pin, int state_pin, int power_pin, const Config& config)
+    : _uart(uart), _config(config), _cmd_pin(cmd_pin), _state_pin(state_pin), _power_pin(power_pin),
+      _baud(config.baud), _pending_baud(config.baud), _name(config.name), _pin(config.pin),
+      _link_random(config.link_seed)
+{
+    _uart.attach(this);
+    setState(false);
+
+    if (_cmd_pin >= 0)
+        host::onPinWrite(_cmd_pin, [this](int value) { onCmdPin(value); });
+
+    if (_power_pin >= 0) {
+        _powered = false;
+        host::onPinWrite(_power_pin, [this](int value) { onPowerPin(value); });
+    }
+}
+
+uint32_t JDY31Sim::settleTime(unsigned long baud) const
+{
+    return _config.settle_min_us + (uint32_t)((uint64_t)_config.settle_bits * 1000000 / baud);
+}
+
+bool JDY31Sim::ready() const
+{
+    return _powered && host::now() >= _ready_at;
+}
+
+void JDY31Sim::setState(bool connected)
+{
+    _connected = connected;
+    if (_state_pin >= 0)
+        host::setPinInput(_state_pin, connected ? HIGH : LOW);
+}
+
+void JDY31Sim::onCmdPin(int value)
+{
+    counters.cmd_edges++;
+    uint32_t generation = ++_cmd_generation;
+    bool target         = value == HIGH;
+
+    host::schedule(host::now() + settleTime(_baud), [this, generation, target]() {
+        if (generation == _cmd_generation)
+            _cmd_mode = target;
+    });
+}
+
+void JDY31Sim::onPowerPin(int value)
+{
+    // Power pin is active high unless the board inverts it, which the
+    // simulation does not model.
+    bool on = value == HIGH;
+    if (on == _powered)
+        return;
+
+    _power_generation++;
+    if (!on) {
+        _powered = false;
+        _line.clear();
+        dropLink();
+        return;
+    }
+
+    _powered = true;
+    reboot(host::now(), _config.boot_us);
+}
+
+void JDY31Sim::reboot(uint64_t at, uint32_t boot_us)
+{
+    _ready_at = at + boot_us;
+    _baud     = _pending_baud;
+    _line.clear();
+    dropLink();
+}
+
+void JDY31Sim::dropLink()
+{
+    _connecting = false;
+    setState(false);
+}
+
+void JDY31Sim::receive(uint8_t value, unsigned long baud)
+{
+    if (!ready())
+        return;
+
+    if (baud != _baud) {
+        counters.garbled++;
+        _line.clear();
+        return;
+    }
+
+    if (!_cmd_mode) {
+        if (_connected)
+            sendToPeer(value);
+        else if (value == '\n')
+            counters.ignored++;
+        return;
+    }
+
+    if (value == '\r')
+        return;
+
+    if (value != '\n') {
+        if (_line.size() < 128)
+            _line.push_back((char)value);
+        return;
+    }
+
+    std::string line = _line;
+    _line.clear();
+    handleLine(line);
+}
+
+void JDY31Sim::sendToPeer(uint8_t value)
+{
+    if (_config.link_rate == 0) {
+        _peer_rx.push_back(value);
+        return;
+    }
+
+    const uint64_t byte_us = 1000000 / _config.link_rate;
+    const uint64_t now     = host::now();
+    uint64_t start         = _link_free_at > now ? _link_free_at : now;
+
+    // Everything not sent yet is still in the buffer
+    if (start - now >= _config.link_buffer * byte_us) {
+        counters.overruns++;
+        return;
+    }
+
+    _link_free_at = start + byte_us;
+
+    _link_random = _link_random * 1103515245 + 12345;
+    if ((_link_random >> 8) % 1000000 < _config.link_loss_ppm) {
+        counters.air_lost++;
+        return;
+    }
+
+    uint32_t generation = _power_generation;
+    host::schedule(_link_free_at + _config.link_latency_us, [this, value, generation]() {
+        if (generation == _power_generation && _connected)
+            _peer_rx.push_back(value);
+    });
+}
+
+void JDY31Sim::handleLine(const std::string& line)
+{
+    if (line.compare(0, 2, "AT") != 0) {
+        counters.ignored++;
+        return;
+    }
+
+    counters.commands++;
+    const uint32_t delay_us = _config.processing_us;
+
+    if (line == "AT+VERSION") {
+        respond("+VERSION=" + _config.version + "\r\n", delay_us);
+    } else if (line == "AT+NAME") {
+        respond("+NAME=" + _name + "\r\n", delay_us);
+    } else if (line.compare(0, 7, "AT+NAME") == 0) {
+        _name = line.substr(7);
+        respond("+OK\r\n", delay_us);
+    } else if (line == "AT+PIN") {
+        respond("+PIN=" + _pin + "\r\n", delay_us);
+    } else if (line.compare(0, 6, "AT+PIN") == 0) {
+        std::string pin = line.substr(6);
+        if (pin.size() != 4 || pin.find_first_not_of("0123456789") != std::string::npos) {
+            respond("ERROR=103\r\n", delay_us);
+            return;
+        }
+        _pin = pin;
+        respond("+OK\r\n", delay_us);
+    } else if (line == "AT+BAUD") {
+        char text[16];
+        for (int i = 0; i < 6; i++)
+            if (RATES[i] == _pending_baud)
+                snprintf(text, sizeof(text), "+BAUD=%d\r\n", i + 4);
+        respond(text, delay_us);
+    } else if (line.compare(0, 7, "AT+BAUD") == 0) {
+        int index = atoi(line.c_str() + 7);
+        if (line.size() != 8 || index < 4 || index > 9) {
+            respond("ERROR=103\r\n", delay_us);
+            return;
+        }
+        _pending_baud = RATES[index - 4];
+        respond("+OK\r\n", delay_us);
+    } else if (line == "AT+RESET") {
+        respond("+OK\r\n", delay_us);
+        counters.resets++;
+        // The reply leaves the module before it goes down
+        reboot(host::now() + delay_us + 5 * host::byteTime(_baud), _config.reset_us);
+    } else if (line == "AT+DEFAULT") {
+        _name         = Config().name;
+        _pin          = Config().pin;
+        _pending_baud = Config().baud;
+        respond("+OK\r\n", delay_us);
+    } else if (line == "AT+DISC") {
+        if (_connected || _connecting) {
+            dropLink();
+            respond("+DISC:SUCCESS\r\n", delay_us);
+        } else {
+            respond("+OK\r\n", delay_us);
+        }
+    } else {
+        respond("ERROR=102\r\n", delay_us);
+    }
+}
+
+void JDY31Sim::respond(const std::string& text, uint32_t delay_us)
+{
+    emit(text, host::now() + delay_us);
+}
+
+void JDY31Sim::emit(const std::string& text, uint64_t at)
+{
+    uint32_t generation = _power_generation;
+
+    for (size_t i = 0; i < text.size(); i++) {
+        uint64_t start = at > _line_free_at ? at : _line_free_at;
+        _line_free_at  = start + host::byteTime(_baud);
+
+        uint8_t value      = (uint8_t)text[i];
+        unsigned long baud = _baud;
+        host::schedule(_line_free_at, [this, value, baud, generation]() {
+            if (generation == _power_generation && _powered)
+                _uart.receive(value, baud);
+        });
+    }
+}
+
+void JDY31Sim::connectPeer(const uint8_t mac[6], uint32_t after_us)
+{
+    uint8_t addr[6];
+    memcpy(addr, mac, 6);
+
+    host::schedule(host::now() + after_us, [this, addr]() {
+        if (!ready())
+            return;
+
+        char text[48];
+        snprintf(text,
+                 sizeof(text),
+                 "+CONNECTING<<%02X:%02X:%02X:%02X:%02X:%02X\r\n",
+                 addr[0],
+                 addr[1],
+                 addr[2],
+                 addr[3],
+                 addr[4],
+                 addr[5]);
+        _connecting = true;
+        emit(text, host::now());
+
+        host::schedule(host::now() + _config.connect_us, [this]() {
+            if (!_connecting)
+                return;
+            _connecting = false;
+            setState(true);
+            emit("CONNECTED\r\n", host::now());
+        });
+    });
+}
+
+void JDY31Sim::disconnectPeer(uint32_t after_us)
+{
+    host::schedule(host::now() + after_us, [this]() {
+        if (!_connected && !_connecting)
+            return;
+        dropLink();
+        emit("+DISC:SUCCESS\r\n", host::now());
+    });
+}
+
+void JDY31Sim::peerSend(const uint8_t* data, size_t length)
+{
+    if (!_connected)
+        return;
+    emit(std::string((const char*)data, length), host::now() + (_config.link_rate > 0 ? _config.link_latency_us : 0));
+}
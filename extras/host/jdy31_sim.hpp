@@ -0,0 +1,188 @@
+#ifndef HOST_JDY31_SIM_HPP
+#define HOST_JDY31_SIM_HPP
+
+#include "host.hpp"
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * Factory state and timing of a simulated module.
+ */
+struct JDY31Config {
+        unsigned long baud     = 9600;
+        std::string name       = "JDY-31-SPP";
+        std::string pin        = "1234";
+        std::string version    = "JDY-31-V1.2";
+        uint32_t processing_us = 2000;   // command in to response out
+        uint32_t reset_us      = 300000; // AT+RESET until ready again
+        uint32_t boot_us       = 400000; // power on until ready
+        uint32_t connect_us    = 600000; // +CONNECTING until CONNECTED
+        uint32_t settle_min_us = 20000;  // cmd pin settle, fixed part
+        uint32_t settle_bits   = 800;    // cmd pin settle, in bit times
+
+        // Radio link to the peer, off while link_rate is 0: data from the
+        // UART goes through a link_buffer byte buffer inside the module that
+        // drains at link_rate bytes/s. Bytes arriving while it is full are
+        // lost, and every byte sent is lost on air with link_loss_ppm.
+        // Data takes link_latency_us more to cross, in both directions.
+        uint32_t link_rate       = 0;
+        uint32_t link_buffer     = 0;
+        uint32_t link_loss_ppm   = 0;
+        uint32_t link_latency_us = 0;
+        uint32_t link_seed       = 1;
+};
+
+/**
+ * Scripted model of a JDY-31 SPP module attached to a simulated Uart.
+ *
+ * The module only sees what was sent at its own baud rate. It enters and
+ * leaves command mode a baud dependent settle time after the command pin
+ * changes, answers the AT commands the library uses after a short
+ * processing delay, and forwards data to the remote peer while connected.
+ * The peer side is scripted with `connectPeer()`, `disconnectPeer()` and
+ * `peerSend()`.
+ */
+class JDY31Sim : public host::UartPeer
+{
+    public:
+        typedef JDY31Config Config;
+
+        struct Counters {
+                uint32_t commands  = 0;
+                uint32_t ignored   = 0; // lines lost outside command mode
+                uint32_t garbled   = 0; // bytes received at the wrong baud
+                uint32_t resets    = 0;
+                uint32_t cmd_edges = 0;
+                uint32_t overruns  = 0; // data lost to a full link buffer
+                uint32_t air_lost  = 0; // data lost on air
+        };
+
+        static const unsigned long RATES[6];
+
+        Counters counters;
+
+        JDY31Sim(Uart& uart, int cmd_pin, int state_pin, int power_pin = -1, const Config& config = Config());
+
+        void receive(uint8_t value, unsigned long baud) override;
+
+        /**
+         * Remote side connects `after_us` from now:
+         * "+CONNECTING<<MAC", then "CONNECTED" once the link is up.
+         */
+        void connectPeer(const uint8_t mac[6], uint32_t after_us = 0);
+
+        /**
+         * Remote side drops the link: "+DISC:SUCCESS".
+         */
+        void disconnectPeer(uint32_t after_us = 0);
+
+        /**
+         * Remote side sends data, delivered to the Uart at the module baud.
+         */
+        void peerSend(const uint8_t* data, size_t length);
+
+        void peerSend(const char* str)
+        {
+            peerSend((const uint8_t*)str, strlen(str));
+        }
+
+        const std::vector<uint8_t>& peerReceived() const
+        {
+            return _peer_rx;
+        }
+
+        void clearPeerReceived()
+        {
+            _peer_rx.clear();
+        }
+
+        bool connected() const
+        {
+            return _connected;
+        }
+
+        bool ready() const;
+
+        /**
+         * When everything handed to the link so far has reached the peer.
+         */
+        uint64_t linkIdleAt() const
+        {
+            return _link_free_at;
+        }
+
+        /**
+         * Radio conditions change: data handed to the link from now on
+         * drains at `rate` bytes/s.
+         */
+        void setLinkRate(uint32_t rate)
+        {
+            _config.link_rate = rate;
+        }
+
+        bool inCommandMode() const
+        {
+            return _cmd_mode;
+        }
+
+        unsigned long baud() const
+        {
+            return _baud;
+        }
+
+        const std::string& name() const
+        {
+            return _name;
+        }
+
+        const std::string& pin() const
+        {
+            return _pin;
+        }
+
+        /**
+         * Time the module needs to follow the command pin at `baud`.
+         */
+        uint32_t settleTime(unsigned long baud) const;
+
+    private:
+        Uart& _uart;
+        Config _config;
+        int _cmd_pin;
+        int _state_pin;
+        int _power_pin;
+
+        unsigned long _baud;
+        unsigned long _pending_baud;
+        std::string _name;
+        std::string _pin;
+
+        bool _powered      = true;
+        bool _cmd_mode     = false;
+        bool _connected    = false;
+        bool _connecting   = false;
+        uint64_t _ready_at = 0;
+        uint32_t _cmd_generation   = 0;
+        uint32_t _power_generation = 0;
+        uint64_t _line_free_at     = 0;
+        uint64_t _link_free_at     = 0;
+        uint32_t _link_random;
+
+        std::string _line;
+        std::vector<uint8_t> _peer_rx;
+
+        void sendToPeer(uint8_t value);
+        void onCmdPin(int value);
+        void onPowerPin(int value);
+        void handleLine(const std::string& line);
+        void respond(const std::string& text, uint32_t delay_us);
+        void emit(const std::string& text, uint64_t at);
+        void dropLink();
+        void reboot(uint64_t at, uint32_t boot_us);
+        void setState(bool connected);
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef BT_FRAME_CODEC_HPP
+#define BT_FRAME_CODEC_HPP
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Binary frames over the SPP byte stream.
+ *
+ * A frame is the payload followed by its CRC-16/CCITT-FALSE (big endian),
+ * COBS encoded so that it contains no zero byte, and terminated by a zero.
+ * A receiver that joins mid-stream or loses bytes resynchronises at the
+ * next zero. The overhead is 4 bytes plus one per 254 payload bytes.
+ */
+
+#define FRAME_DELIMITER 0x00
+#define FRAME_CRC_SIZE  2
+
+inline uint16_t frameCrc16(uint16_t crc, uint8_t value)
+{
+    static const uint16_t table[16] = { 0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+                                        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF };
+
+    crc = (crc << 4) ^ table[(crc >> 12) ^ (value >> 4)];
+    crc = (crc << 4) ^ table[(crc >> 12) ^ (value & 0x0F)];
+    return crc;
+}
+
+inline uint16_t frameCrc16(const uint8_t* data, size_t length)
+{
+    uint16_t crc = 0xFFFF;
+
+    for (size_t i = 0; i < length; i++)
+        crc = frameCrc16(crc, data[i]);
+
+    return crc;
+}
+
+/**
+ * Encodes straight from the caller's payload, either into a caller buffer
+ * or onto a Print, without an intermediate copy.
+ */
+class FrameEncoder
+{
+    private:
+        struct BufferSink {
+                uint8_t* out;
+                size_t capacity;
+                size_t length;
+
+                bool write(const uint8_t* data, size_t count)
+                {
+                    if (count > capacity - length)
+                        return false;
+
+                    memcpy(out + length, data, count);
+                    length += count;
+                    return true;
+                }
+        };
+
+        struct PrintSink {
+                Print& out;
+                size_t length;
+
+                bool write(const uint8_t* data, size_t count)
+                {
+                    size_t written = count == 1 ? out.write(data[0]) : out.write(data, count);
+                    length += written;
+                    return written == count;
+                }
+        };
+
+    public:
+        /**
+         * COBS over payload + CRC onto any `sink` with
+         * `bool write(const uint8_t* data, size_t count)`. Runs of payload
+         * bytes go to the sink as they are; only the code bytes and the CRC
+         * are produced here.
+         */
+        template <class Sink>
+        static bool encode(Sink& sink, const uint8_t* data, size_t length)
+        {
+            const uint16_t crc_value = frameCrc16(data, length);
+            const uint8_t crc[]      = { (uint8_t)(crc_value >> 8), (uint8_t)crc_value };
+            const uint8_t delimiter  = FRAME_DELIMITER;
+            const size_t total       = length + FRAME_CRC_SIZE;
+            size_t start             = 0;
+
+            for (;;) {
+                size_t end = start;
+                while (end < total && end - start < 254 && (end < length ? data[end] : crc[end - length]) != 0)
+                    end++;
+
+                uint8_t code = (uint8_t)(end - start + 1);
+                if (!sink.write(&code, 1))
+                    return false;
+
+                if (start < length && !sink.write(data + start, min(end, length) - start))
+                    return false;
+
+                if (end > length && !sink.write(crc + max(start, length) - length, end - max(start, length)))
+                    return false;
+
+                if (end == total)
+                    break;
+
+                // A full block is not followed by an implicit zero
+                start = end - start == 254 ? end : end + 1;
+            }
+
+            return sink.write(&delimiter, 1);
+        }
+
+        /**
+         * Worst case encoded size of a `length` byte payload, delimiter included.
+         */
+        static size_t maxLength(size_t length)
+        {
+            size_t total = length + FRAME_CRC_SIZE;
+            return total + total / 254 + 2;
+        }
+
+        /**
+         * Encode into `out`. Returns the encoded length, 0 if it does not fit.
+         */
+        static size_t encode(const uint8_t* data, size_t length, uint8_t* out, size_t capacity)
+        {
+            BufferSink sink = { out, capacity, 0 };
+            return encode(sink, data, length) ? sink.length : 0;
+        }
+
+        /**
+         * Encode onto `out`. Returns the number of bytes written, 0 if `out`
+         * did not accept all of them.
+         */
+        static size_t write(Print& out, const uint8_t* data, size_t length)
+        {
+            PrintSink sink = { out, 0 };
+            return encode(sink, data, length) ? sink.length : 0;
+        }
+};
+
+enum FrameStatus {
+    FRAME_PENDING,
+    FRAME_READY,
+    FRAME_CRC_ERROR,
+    FRAME_OVERFLOW,
+    FRAME_MALFORMED,
+};
+
+/**
+ * Incremental decoder writing into a caller supplied buffer, which must
+ * hold the largest expected payload plus FRAME_CRC_SIZE bytes.
+ *
+ * Each byte is fed once. The CRC is updated on the way, so a frame is
+ * checked as soon as its delimiter arrives.
+ */
+class FrameDecoder
+{
+    private:
+        uint8_t* _buffer;
+        size_t _capacity;
+        size_t _length     = 0;
+        uint16_t _crc      = 0xFFFF;
+        uint8_t _remaining = 0;
+        bool _zero_pending = false;
+        bool _started      = false;
+        FrameStatus _error = FRAME_PENDING;
+        uint32_t _frames   = 0;
+        uint32_t _errors   = 0;
+
+        void append(uint8_t value)
+        {
+            if (_length == _capacity) {
+                _error = FRAME_OVERFLOW;
+                return;
+            }
+
+            _buffer[_length++] = value;
+            _crc               = frameCrc16(_crc, value);
+        }
+
+        FrameStatus finish()
+        {
+            FrameStatus status = _error;
+
+            if (!_started)
+                return FRAME_PENDING;
+
+            if (status == FRAME_PENDING) {
+                if (_remaining != 0 || _length < FRAME_CRC_SIZE)
+                    status = FRAME_MALFORMED;
+                else if (_crc != 0) // The CRC of payload + its CRC is zero
+                    status = FRAME_CRC_ERROR;
+                else
+                    status = FRAME_READY;
+            }
+
+            if (status == FRAME_READY)
+                _frames++;
+            else
+                _errors++;
+
+            return status;
+        }
+
+    public:
+        FrameDecoder(uint8_t* buffer, size_t capacity) : _buffer(buffer), _capacity(capacity)
+        {
+        }
+
+        /**
+         * Forget the frame in progress, e.g. after the stream was interrupted.
+         */
+        void reset()
+        {
+            _length       = 0;
+            _crc          = 0xFFFF;
+            _remaining    = 0;
+            _zero_pending = false;
+            _started      = false;
+            _error        = FRAME_PENDING;
+        }
+
+        /**
+         * Returns FRAME_PENDING until `c` is a delimiter, then the outcome of
+         * the frame it ends. On FRAME_READY the payload is at `data()` until
+         * the next byte is fed.
+         */
+        FrameStatus feed(uint8_t c)
+        {
+            if (c == FRAME_DELIMITER) {
+                FrameStatus status = finish();
+                size_t length      = _length;
+
+                reset();
+                _length = status == FRAME_READY ? length - FRAME_CRC_SIZE : 0;
+                return status;
+            }
+
+            // A frame's first byte after a delivered one starts from scratch
+            if (!_started)
+                _length = 0;
+
+            if (_error != FRAME_PENDING)
+                return FRAME_PENDING;
+
+            if (_remaining == 0) {
+                if (_started && _zero_pending)
+                    append(0);
+
+                _remaining    = c - 1;
+                _zero_pending = c != 0xFF;
+                _started      = true;
+            } else {
+                append(c);
+                _remaining--;
+            }
+
+            return FRAME_PENDING;
+        }
+
+        const uint8_t* data() const
+        {
+            return _buffer;
+        }
+
+        size_t length() const
+        {
+            return _length;
+        }
+
+        uint32_t frames() const
+        {
+            return _frames;
+        }
+
+        uint32_t errors() const
+        {
+            return _errors;
+        }
+};
+
+#endif
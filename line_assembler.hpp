@@ -0,0 +1,95 @@
+#ifndef BT_LINE_ASSEMBLER_HPP
+#define BT_LINE_ASSEMBLER_HPP
+
+#include <Arduino.h>
+#include <stdint.h>
+
+enum LineStatus {
+    LINE_PENDING,
+    LINE_READY,
+    LINE_OVERFLOW,
+};
+
+/**
+ * Builds `\n` terminated lines from bytes fed one at a time, across as many
+ * calls as it takes. `\r` is dropped and so are empty lines.
+ *
+ * A line longer than `N` keeps its first `N` characters and is reported as
+ * LINE_OVERFLOW instead of LINE_READY, so truncation is never silent.
+ */
+template <size_t N>
+class LineAssembler
+{
+    private:
+        char _line[N + 1];
+        size_t _length      = 0;
+        bool _overflow      = false;
+        bool _complete      = false;
+        uint32_t _overflows = 0;
+
+    public:
+        void reset()
+        {
+            _length   = 0;
+            _overflow = false;
+            _complete = false;
+        }
+
+        /**
+         * Returns LINE_PENDING until `c` ends a non-empty line. The line is
+         * then readable with `line()` until the next byte is fed.
+         */
+        LineStatus feed(char c)
+        {
+            if (_complete)
+                reset();
+
+            if (c == '\r')
+                return LINE_PENDING;
+
+            if (c == '\n') {
+                if (_length == 0 && !_overflow)
+                    return LINE_PENDING;
+
+                _line[_length] = 0;
+                _complete      = true;
+
+                if (_overflow) {
+                    _overflows++;
+                    return LINE_OVERFLOW;
+                }
+                return LINE_READY;
+            }
+
+            if (_length == N) {
+                _overflow = true;
+                return LINE_PENDING;
+            }
+
+            _line[_length++] = c;
+            return LINE_PENDING;
+        }
+
+        /**
+         * The NUL-terminated line, without its line ending.
+         */
+        const char* line() const
+        {
+            return _line;
+        }
+
+        size_t length() const
+        {
+            return _length;
+        }
+
+        /**
+         * Lines that did not fit so far.
+         */
+        uint32_t overflows() const
+        {
+            return _overflows;
+        }
+};
+
+#endif
@@ -0,0 +1,117 @@
+#ifndef BT_PACING_CONTROL_HPP
+#define BT_PACING_CONTROL_HPP
+
+#include <Arduino.h>
+#include <stdint.h>
+
+struct PacingSample {
+        uint32_t at_ms; // millis() when the rate changed
+        uint32_t rate;  // bytes/s from then on
+};
+
+/**
+ * AIMD rate control: the rate grows by `step` bytes/s for every reported
+ * delivery and is cut to `decrease_num / decrease_den` of itself on every
+ * reported loss, always within [min_rate, max_rate].
+ *
+ * The last `H` rate changes are kept, oldest first.
+ */
+template <uint8_t H>
+class PacingControl
+{
+    private:
+        uint32_t _rate;
+        uint32_t _min_rate;
+        uint32_t _max_rate;
+        uint32_t _step;
+        uint8_t _decrease_num;
+        uint8_t _decrease_den;
+
+        PacingSample _history[H];
+        uint8_t _history_next  = 0;
+        uint8_t _history_count = 0;
+
+        uint32_t _increases = 0;
+        uint32_t _decreases = 0;
+
+        void record()
+        {
+            if (_history_count > 0) {
+                PacingSample& last = _history[(_history_next + H - 1) % H];
+                if (last.rate == _rate)
+                    return;
+            }
+
+            _history[_history_next] = { (uint32_t)millis(), _rate };
+            _history_next           = (_history_next + 1) % H;
+            _history_count          = min((uint8_t)(_history_count + 1), H);
+        }
+
+    public:
+        PacingControl(uint32_t rate, uint32_t min_rate, uint32_t max_rate, uint32_t step, uint8_t decrease_num, uint8_t decrease_den)
+            : _rate(rate), _min_rate(min_rate), _max_rate(max_rate), _step(step), _decrease_num(decrease_num),
+              _decrease_den(decrease_den)
+        {
+        }
+
+        /**
+         * Start over at `rate`, forgetting the history.
+         */
+        void reset(uint32_t rate)
+        {
+            _rate          = min(max(rate, _min_rate), _max_rate);
+            _history_next  = 0;
+            _history_count = 0;
+            record();
+        }
+
+        /**
+         * The peer confirmed data: additive increase.
+         */
+        void delivered()
+        {
+            _rate = min(_rate + _step, _max_rate);
+            _increases++;
+            record();
+        }
+
+        /**
+         * The peer reported loss: multiplicative decrease.
+         */
+        void lost()
+        {
+            _rate = max((uint32_t)((uint64_t)_rate * _decrease_num / _decrease_den), _min_rate);
+            _decreases++;
+            record();
+        }
+
+        uint32_t rate() const
+        {
+            return _rate;
+        }
+
+        uint8_t historyCount() const
+        {
+            return _history_count;
+        }
+
+        /**
+         * `index` 0 is the oldest change kept.
+         */
+        PacingSample history(uint8_t index) const
+        {
+            return _history[(_history_next + H - _history_count + index) % H];
+        }
+
+        uint32_t increases() const
+        {
+            return _increases;
+        }
+
+        uint32_t decreases() const
+        {
+            return _decreases;
+        }
+};
+
+#endif
@@ -0,0 +1,185 @@
+#ifndef BT_RESPONSE_PARSER_HPP
+#define BT_RESPONSE_PARSER_HPP
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Characters inside a buffer owned by someone else. Not NUL-terminated,
+ * and only valid for as long as that buffer keeps its content.
+ */
+struct BtStringView {
+        const char* data;
+        uint8_t length;
+
+        bool empty() const
+        {
+            return length == 0;
+        }
+
+        bool equals(const char* text) const
+        {
+            return strlen(text) == length && memcmp(data, text, length) == 0;
+        }
+};
+
+enum ResponseKind {
+    RESPONSE_UNKNOWN,
+    RESPONSE_OK,
+    RESPONSE_ERROR,
+    RESPONSE_VERSION,
+    RESPONSE_NAME,
+    RESPONSE_PIN,
+    RESPONSE_BAUD,
+    RESPONSE_CONNECTING,
+    RESPONSE_CONNECTED,
+    RESPONSE_DISCONNECTED,
+};
+
+/**
+ * A module line, parsed in place.
+ */
+struct ModuleResponse {
+        ResponseKind kind;
+        BtStringView value; // what follows the prefix ("+NAME=", "+CONNECTING<<"...)
+        int8_t baud_index;  // RESPONSE_BAUD: the module's index ("+BAUD=4" is 9600), else -1
+        uint8_t mac[6];     // RESPONSE_CONNECTING: the peer address, when well formed
+};
+
+/**
+ * Turns reply and URC lines into ModuleResponse without copying: text
+ * values point into the line, only the baud index and the MAC address
+ * are decoded.
+ *
+ * The prefix is picked by its second character, so a line costs one
+ * switch and one prefix comparison.
+ */
+class ResponseParser
+{
+    private:
+        static bool startsWith(const char* line, size_t length, const char* prefix, size_t prefix_length)
+        {
+            return length >= prefix_length && strncmp_P(line, prefix, prefix_length) == 0;
+        }
+
+        static ResponseKind match(const char* line, size_t length, size_t* prefix_length)
+        {
+            if (length < 2)
+                return RESPONSE_UNKNOWN;
+
+#define BT_RESPONSE_PREFIX(text, kind)                              \
+    if (startsWith(line, length, PSTR(text), sizeof(text) - 1)) { \
+        *prefix_length = sizeof(text) - 1;                        \
+        return kind;                                              \
+    }
+
+            switch (line[1]) {
+                case 'O':
+                    BT_RESPONSE_PREFIX("+OK", RESPONSE_OK);
+                    BT_RESPONSE_PREFIX("CONNECTED", RESPONSE_CONNECTED);
+                    break;
+                case 'R':
+                    BT_RESPONSE_PREFIX("ERROR", RESPONSE_ERROR);
+                    break;
+                case 'V':
+                    BT_RESPONSE_PREFIX("+VERSION=", RESPONSE_VERSION);
+                    break;
+                case 'N':
+                    BT_RESPONSE_PREFIX("+NAME=", RESPONSE_NAME);
+                    break;
+                case 'P':
+                    BT_RESPONSE_PREFIX("+PIN=", RESPONSE_PIN);
+                    break;
+                case 'B':
+                    BT_RESPONSE_PREFIX("+BAUD=", RESPONSE_BAUD);
+                    break;
+                case 'C':
+                    BT_RESPONSE_PREFIX("+CONNECTING<<", RESPONSE_CONNECTING);
+                    break;
+                case 'D':
+                    BT_RESPONSE_PREFIX("+DISC:SUCCESS", RESPONSE_DISCONNECTED);
+                    break;
+            }
+
+#undef BT_RESPONSE_PREFIX
+
+            return RESPONSE_UNKNOWN;
+        }
+
+    public:
+        /**
+         * Value of a hex digit (either case), 0xFF for anything else.
+         */
+        static uint8_t hexNibble(char c)
+        {
+            // '0' to 'f'
+            static const uint8_t DIGITS[] PROGMEM = {
+                0,    1,    2,    3,    4,    5,    6,    7,    8,    9,    0xFF, 0xFF, 0xFF, 0xFF,
+                0xFF, 0xFF, 0xFF, 10,   11,   12,   13,   14,   15,   0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 10,   11,   12,   13,   14,   15,
+            };
+
+            uint8_t index = (uint8_t)(c - '0');
+            return index < sizeof(DIGITS) ? pgm_read_byte(&DIGITS[index]) : 0xFF;
+        }
+
+        /**
+         * Six hex pairs, each but the last optionally followed by ':'.
+         */
+        static bool parseMac(const char* text, size_t length, uint8_t mac[6])
+        {
+            size_t at = 0;
+
+            for (uint8_t i = 0; i < 6; i++) {
+                if (at + 2 > length)
+                    return false;
+
+                uint8_t high = hexNibble(text[at]);
+                uint8_t low  = hexNibble(text[at + 1]);
+                if ((high | low) == 0xFF)
+                    return false;
+
+                mac[i] = (uint8_t)(high << 4 | low);
+                at += 2;
+
+                if (i < 5 && at < length && text[at] == ':')
+                    at++;
+            }
+
+            return true;
+        }
+
+        /**
+         * Parse `line` (without its line ending). Returns false for a line
+         * that is not a known reply, or a known one with a malformed value.
+         */
+        static bool parse(const char* line, size_t length, ModuleResponse* response)
+        {
+            size_t prefix_length = 0;
+
+            response->kind       = match(line, length, &prefix_length);
+            response->value      = { line + prefix_length, (uint8_t)(length - prefix_length) };
+            response->baud_index = -1;
+
+            switch (response->kind) {
+                case RESPONSE_UNKNOWN:
+                    return false;
+
+                case RESPONSE_BAUD:
+                    if (response->value.length != 1 || response->value.data[0] < '0' || response->value.data[0] > '9')
+                        return false;
+                    response->baud_index = response->value.data[0] - '0';
+                    return true;
+
+                case RESPONSE_CONNECTING:
+                    return parseMac(response->value.data, response->value.length, response->mac);
+
+                default:
+                    return true;
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,158 @@
+#ifndef BT_RING_BUFFER_HPP
+#define BT_RING_BUFFER_HPP
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * Fixed size byte FIFO. `N` must be a power of two.
+ *
+ * Head and tail run freely and are masked on access, so a full buffer
+ * holds exactly `N` bytes.
+ */
+template <size_t N>
+class RingBuffer
+{
+        static_assert(N > 0 && (N & (N - 1)) == 0, "RingBuffer size must be a power of two");
+
+    private:
+        uint8_t _data[N];
+        size_t _head = 0;
+        size_t _tail = 0;
+
+    public:
+        size_t available() const
+        {
+            return _tail - _head;
+        }
+
+        size_t free() const
+        {
+            return N - available();
+        }
+
+        bool full() const
+        {
+            return available() == N;
+        }
+
+        void clear()
+        {
+            _head = _tail;
+        }
+
+        bool push(uint8_t value)
+        {
+            if (full())
+                return false;
+
+            _data[_tail++ & (N - 1)] = value;
+            return true;
+        }
+
+        int pop()
+        {
+            if (available() == 0)
+                return -1;
+
+            return _data[_head++ & (N - 1)];
+        }
+
+        int peek() const
+        {
+            if (available() == 0)
+                return -1;
+
+            return _data[_head & (N - 1)];
+        }
+
+        /**
+         * Oldest unread bytes stored contiguously. Returns their count,
+         * which may be less than `available()` when the data wraps.
+         */
+        size_t peekContiguous(const uint8_t** data) const
+        {
+            size_t offset = _head & (N - 1);
+            size_t length = min(available(), N - offset);
+
+            *data = &_data[offset];
+            return length;
+        }
+
+        void consume(size_t length)
+        {
+            _head += min(length, available());
+        }
+
+        /**
+         * Append as much of `buffer` as fits. Returns the number of bytes stored.
+         */
+        size_t write(const uint8_t* buffer, size_t length)
+        {
+            size_t stored = 0;
+
+            while (stored < length && !full()) {
+                size_t offset = _tail & (N - 1);
+                size_t chunk  = min(min(free(), N - offset), length - stored);
+
+                memcpy(&_data[offset], buffer + stored, chunk);
+                _tail += chunk;
+                stored += chunk;
+            }
+
+            return stored;
+        }
+
+        /**
+         * Copy up to `length` bytes into `buffer`.
+         */
+        size_t read(uint8_t* buffer, size_t length)
+        {
+            size_t copied = 0;
+
+            while (copied < length && available() > 0) {
+                const uint8_t* data;
+                size_t chunk = min(peekContiguous(&data), length - copied);
+
+                memcpy(buffer + copied, data, chunk);
+                consume(chunk);
+                copied += chunk;
+            }
+
+            return copied;
+        }
+
+        /**
+         * Copy bytes into `buffer` until `terminator`, `length` bytes or the end
+         * of the data. A found terminator is consumed but not copied.
+         */
+        size_t readUntil(uint8_t terminator, uint8_t* buffer, size_t length, bool* found)
+        {
+            size_t copied = 0;
+            *found        = false;
+
+            while (copied < length && available() > 0) {
+                const uint8_t* data;
+                size_t chunk     = min(peekContiguous(&data), length - copied);
+                const void* stop = memchr(data, terminator, chunk);
+
+                if (stop != NULL)
+                    chunk = (const uint8_t*)stop - data;
+
+                memcpy(buffer + copied, data, chunk);
+                consume(chunk);
+                copied += chunk;
+
+                if (stop != NULL) {
+                    consume(1);
+                    *found = true;
+                    break;
+                }
+            }
+
+            return copied;
+        }
+};
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef BT_SPSC_QUEUE_HPP
+#define BT_SPSC_QUEUE_HPP
+
+#include <Arduino.h>
+#include <stdint.h>
+
+/**
+ * Wait-free byte FIFO between one producer (an interrupt handler) and one
+ * consumer (the main loop). `N` must be a power of two.
+ *
+ * Each side only writes its own index and publishes it with a release
+ * store after touching the data, so neither side ever waits or masks
+ * interrupts. This needs `size_t` loads and stores to be single
+ * instructions, as on every 32-bit target.
+ *
+ * Producer side: `push()`, `overflows()`. Consumer side: everything else.
+ */
+template <size_t N>
+class SpscQueue
+{
+        static_assert(N > 0 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+    private:
+        uint8_t _data[N];
+        size_t _head        = 0; // next byte to read, written by the consumer
+        size_t _tail        = 0; // next free slot, written by the producer
+        uint32_t _overflows = 0; // bytes dropped on a full queue, written by the producer
+
+    public:
+        /**
+         * Producer: store `value`, or drop and count it when full.
+         */
+        bool push(uint8_t value)
+        {
+            size_t tail = _tail;
+
+            if (tail - __atomic_load_n(&_head, __ATOMIC_ACQUIRE) == N) {
+                __atomic_store_n(&_overflows, _overflows + 1, __ATOMIC_RELAXED);
+                return false;
+            }
+
+            _data[tail & (N - 1)] = value;
+            __atomic_store_n(&_tail, tail + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        /**
+         * Consumer: oldest byte, or -1 when empty.
+         */
+        int pop()
+        {
+            size_t head = _head;
+
+            if (__atomic_load_n(&_tail, __ATOMIC_ACQUIRE) == head)
+                return -1;
+
+            uint8_t value = _data[head & (N - 1)];
+            __atomic_store_n(&_head, head + 1, __ATOMIC_RELEASE);
+            return value;
+        }
+
+        /**
+         * Consumer: copy up to `length` bytes into `buffer`, publishing the
+         * freed space once. Returns the number of bytes copied.
+         */
+        size_t pop(uint8_t* buffer, size_t length)
+        {
+            size_t head   = _head;
+            size_t copied = min(__atomic_load_n(&_tail, __ATOMIC_ACQUIRE) - head, length);
+
+            for (size_t i = 0; i < copied; i++)
+                buffer[i] = _data[(head + i) & (N - 1)];
+
+            __atomic_store_n(&_head, head + copied, __ATOMIC_RELEASE);
+            return copied;
+        }
+
+        size_t available() const
+        {
+            return __atomic_load_n(&_tail, __ATOMIC_ACQUIRE) - _head;
+        }
+
+        /**
+         * Consumer: drop everything received so far.
+         */
+        void clear()
+        {
+            __atomic_store_n(&_head, __atomic_load_n(&_tail, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        }
+
+        uint32_t overflows() const
+        {
+            return __atomic_load_n(&_overflows, __ATOMIC_RELAXED);
+        }
+};
+
+#endif
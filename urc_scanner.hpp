@@ -0,0 +1,166 @@
+#ifndef BT_URC_SCANNER_HPP
+#define BT_URC_SCANNER_HPP
+
+#include <Arduino.h>
+#include <stdint.h>
+
+enum UrcType {
+    URC_NONE = -1,
+    URC_CONNECTING,
+    URC_CONNECTED,
+    URC_DISCONNECTED,
+    URC_COUNT,
+};
+
+/**
+ * Streaming matcher for the module's unsolicited result codes.
+ *
+ * URCs start at the beginning of a line. The known prefixes form a trie
+ * that is laid out at compile time: a node is the lowest numbered prefix
+ * reaching it plus a depth, and the only table needed is, for every node,
+ * the next prefix branching off the same parent. Every received byte is fed
+ * once and costs one comparison, plus one per sibling tried where prefixes
+ * diverge.
+ */
+class UrcScanner
+{
+    private:
+        static const uint8_t DEPTHS = 16; // longest prefix + 1
+        static const uint8_t NO_URC = 0xFF;
+
+        uint8_t _type  = 0;
+        uint8_t _depth = 0;
+
+        static constexpr const char* prefix(uint8_t type)
+        {
+            return type == URC_CONNECTING ? "+CONNECTING" : type == URC_CONNECTED ? "CONNECTED" : "+DISC:SUCCESS";
+        }
+
+        static constexpr uint8_t length(const char* text)
+        {
+            return text[0] == 0 ? 0 : 1 + length(text + 1);
+        }
+
+        static constexpr uint8_t longest(uint8_t type = 0)
+        {
+            return type == URC_COUNT ? 0 : length(prefix(type)) > longest(type + 1) ? length(prefix(type)) : longest(type + 1);
+        }
+
+        static constexpr bool samePath(const char* a, const char* b, uint8_t depth)
+        {
+            return depth == 0 || (a[0] != 0 && a[0] == b[0] && samePath(a + 1, b + 1, depth - 1));
+        }
+
+        /**
+         * Whether `type` is the lowest numbered prefix through its node at `depth`.
+         */
+        static constexpr bool owns(uint8_t type, uint8_t depth, uint8_t other = 0)
+        {
+            return other >= type || (!samePath(prefix(other), prefix(type), depth) && owns(type, depth, other + 1));
+        }
+
+        /**
+         * Next child of the node `type` leaves at `depth`, after the one
+         * `type` takes, or NO_URC.
+         */
+        static constexpr uint8_t sibling(uint8_t type, uint8_t depth, uint8_t other)
+        {
+            return other >= URC_COUNT ? NO_URC
+                   : samePath(prefix(type), prefix(other), depth) && prefix(other)[depth] != 0
+                           && prefix(other)[depth] != prefix(type)[depth] && owns(other, depth + 1)
+                       ? other
+                       : sibling(type, depth, other + 1);
+        }
+
+        static constexpr uint8_t siblingAt(uint8_t index)
+        {
+            return index / DEPTHS >= URC_COUNT || index % DEPTHS >= length(prefix(index / DEPTHS))
+                       ? NO_URC
+                       : sibling(index / DEPTHS, index % DEPTHS, index / DEPTHS + 1);
+        }
+
+        template <uint8_t... I>
+        struct Indexes {};
+
+        template <uint8_t N, uint8_t... I>
+        struct MakeIndexes : MakeIndexes<N - 1, N - 1, I...> {};
+
+        template <uint8_t... I>
+        struct MakeIndexes<0, I...> {
+                typedef Indexes<I...> type;
+        };
+
+        template <uint8_t... I>
+        static uint8_t siblings(uint8_t index, Indexes<I...>)
+        {
+            static const uint8_t table[] PROGMEM = { siblingAt(I)... };
+            return pgm_read_byte(&table[index]);
+        }
+
+        static uint8_t sibling(uint8_t type, uint8_t depth)
+        {
+            static_assert(longest() < DEPTHS, "URC prefix too long for the trie table");
+
+            return siblings(type * DEPTHS + depth, typename MakeIndexes<URC_COUNT * DEPTHS>::type());
+        }
+
+    public:
+        UrcScanner()
+        {
+            reset();
+        }
+
+        void reset()
+        {
+            _type  = 0;
+            _depth = 0;
+        }
+
+        /**
+         * Returns the URC whose prefix `c` completes, or URC_NONE.
+         */
+        UrcType feed(char c)
+        {
+            if (c == '\n' || c == '\r') {
+                reset();
+                return URC_NONE;
+            }
+
+            if (_type == NO_URC)
+                return URC_NONE;
+
+            uint8_t type = _type;
+            while (type != NO_URC && prefix(type)[_depth] != c)
+                type = sibling(type, _depth);
+
+            _type = type;
+            if (type == NO_URC)
+                return URC_NONE;
+
+            _depth++;
+            if (prefix(type)[_depth] != 0)
+                return URC_NONE;
+
+            // The rest of the line is the URC's payload
+            _type = NO_URC;
+            return (UrcType)type;
+        }
+
+        /**
+         * Whether the current line may still turn out to be a URC.
+         */
+        bool matching() const
+        {
+            return _type != NO_URC;
+        }
+
+        /**
+         * Characters of the current line matched so far.
+         */
+        uint8_t position() const
+        {
+            return _depth;
+        }
+};
+
+#endif